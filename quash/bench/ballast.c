@@ -0,0 +1,35 @@
+/**
+ * @file ballast.c
+ *
+ * @brief Preloaded into quash by spawn_rss.sh to grow its resident size
+ *
+ * Allocates and touches BALLAST_MIB MiB before main() runs, then removes
+ * itself from the environment so the programs quash starts run without it.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+
+// Kept so the pages stay resident for the life of the process
+static volatile char* ballast;
+
+__attribute__((constructor))
+static void grow_ballast() {
+
+	const char* mib = getenv("BALLAST_MIB");
+
+	if(NULL != mib){
+		size_t size = strtoul(mib, NULL, 10) << 20;
+
+		ballast = malloc(size);
+
+		// Write one byte per page so every page is backed
+		for(size_t i = 0; NULL != ballast && i < size; i += 4096){
+			ballast[i] = 1;
+		}
+	}
+
+	unsetenv("BALLAST_MIB");
+	unsetenv("LD_PRELOAD");
+}
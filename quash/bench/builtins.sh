@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+# Lines per second of a script made only of builtins
+#
+# Feeds quash a script that cycles through echo, pwd and export, and times
+# the whole run. The output goes to /dev/null.
+#
+# usage: bench/builtins.sh [quash] [lines] [runs]
+
+QUASH=$(realpath "${1:-./quash}")
+LINES=${2:-10000}
+RUNS=${3:-5}
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+for (( i = 0; i < LINES; i++ )); do
+	case $(( i % 3 )) in
+		0) echo "echo line $i" ;;
+		1) echo "pwd" ;;
+		2) echo "export BENCH_LINE=$i" ;;
+	esac
+done > "$TMP/builtins.in"
+
+printf "%8s %10s %10s\n" "run" "ms" "lines/s"
+
+for (( run = 1; run <= RUNS; run++ )); do
+	t0=$(date +%s%N)
+	"$QUASH" < "$TMP/builtins.in" > /dev/null 2>&1
+	t1=$(date +%s%N)
+
+	awk -v run="$run" -v n="$LINES" -v t0="$t0" -v t1="$t1" \
+	    'BEGIN { ms = (t1 - t0) / 1e6
+	             printf "%8d %10.0f %10.0f\n", run, ms, n * 1e3 / ms }'
+done
@@ -0,0 +1,166 @@
+/**
+ * @file deque_bench.c
+ *
+ * @brief Times push and pop loops on the deques generated by deque.h
+ *
+ * Built by `make bench`. Each loop runs on a deque of int, like pid_queue,
+ * and on a deque of job_struct, the largest element quash stores. The fill
+ * loop starts a new deque of capacity one, pushes FILL_LENGTH elements and
+ * pops them all, over and over, so it times the growth as well. The queue
+ * loop keeps a few elements in one deque and pushes one for every one it
+ * pops, so the front and back keep wrapping around.
+ *
+ * usage: ./deque_bench [operations]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deque.h"
+#include "job_struct.h"
+
+IMPLEMENT_DEQUE_STRUCT(int_deque, int);
+IMPLEMENT_DEQUE(int_deque, int);
+
+IMPLEMENT_DEQUE_STRUCT(job_deque, job_struct);
+IMPLEMENT_DEQUE(job_deque, job_struct);
+
+// Elements pushed into each new deque by the fill loop
+#define FILL_LENGTH 1024
+
+// Elements kept in the deque by the queue loop
+#define QUEUE_LENGTH 16
+
+// Summed by every loop so the pops cannot be optimized away
+static volatile long sink;
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// Nanoseconds of CLOCK_MONOTONIC
+static double now_ns() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+// Print one row of results
+static void report(const char* type, const char* loop, long ops, double ns) {
+	printf("%-12s %-6s %12ld %10.2f\n", type, loop, ops, ns / ops);
+}
+
+
+static void bench_int(long ops) {
+
+	int_deque deq;
+	long sum = 0;
+	double start = now_ns();
+
+	for(long done = 0; done < ops; done += FILL_LENGTH){
+		deq = new_int_deque(1);
+
+		for(long i = 0; i < FILL_LENGTH; i++){
+			push_back_int_deque(&deq, i);
+		}
+		while(!is_empty_int_deque(&deq)){
+			sum += pop_front_int_deque(&deq);
+		}
+
+		destroy_int_deque(&deq);
+	}
+
+	report("int", "fill", ops, now_ns() - start);
+
+	deq = new_int_deque(1);
+	start = now_ns();
+
+	for(long i = 0; i < QUEUE_LENGTH; i++){
+		push_back_int_deque(&deq, i);
+	}
+	for(long i = 0; i < ops; i++){
+		push_back_int_deque(&deq, i);
+		sum += pop_front_int_deque(&deq);
+	}
+
+	report("int", "queue", ops, now_ns() - start);
+
+	destroy_int_deque(&deq);
+	sink = sum;
+}
+
+
+static void bench_job(long ops) {
+
+	job_deque deq;
+	job_struct job;
+	long sum = 0;
+
+	memset(&job, 0, sizeof(job));
+
+	double start = now_ns();
+
+	for(long done = 0; done < ops; done += FILL_LENGTH){
+		deq = new_job_deque(1);
+
+		for(long i = 0; i < FILL_LENGTH; i++){
+			job.job_id = i;
+			push_back_job_deque(&deq, job);
+		}
+		while(!is_empty_job_deque(&deq)){
+			sum += pop_front_job_deque(&deq).job_id;
+		}
+
+		destroy_job_deque(&deq);
+	}
+
+	report("job_struct", "fill", ops, now_ns() - start);
+
+	deq = new_job_deque(1);
+	start = now_ns();
+
+	for(long i = 0; i < QUEUE_LENGTH; i++){
+		push_back_job_deque(&deq, job);
+	}
+	for(long i = 0; i < ops; i++){
+		job.job_id = i;
+		push_back_job_deque(&deq, job);
+		sum += pop_front_job_deque(&deq).job_id;
+	}
+
+	report("job_struct", "queue", ops, now_ns() - start);
+
+	destroy_job_deque(&deq);
+	sink = sum;
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+int main(int argc, char** argv) {
+
+	long ops = (argc > 1) ? atol(argv[1]) : 10000000;
+
+	if(ops <= 0){
+		fprintf(stderr, "usage: %s [operations]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-12s %-6s %12s %10s\n", "type", "loop", "ops", "ns/op");
+
+	bench_int(ops);
+	bench_job(ops);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+# Lines per second with the fast parser off and on
+#
+# Generates two scripts the fast path accepts and times quash reading each
+# under QUASH_FAST_PARSE=0 and QUASH_FAST_PARSE=1. In the first every line
+# is an echo into /dev/null, which costs the same to run either way. The
+# second is only comments, so it measures reading and parsing alone.
+#
+# usage: bench/parse.sh [quash] [lines] [runs]
+
+QUASH=$(realpath "${1:-./quash}")
+LINES=${2:-200000}
+RUNS=${3:-3}
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+for (( i = 0; i < LINES; i++ )); do
+	echo "echo alpha beta gamma $i delta > /dev/null # line $i"
+done > "$TMP/echo.in"
+
+for (( i = 0; i < LINES; i++ )); do
+	echo "# alpha beta gamma $i delta | wc -c > /dev/null"
+done > "$TMP/comment.in"
+
+printf "%8s %8s %8s %10s %10s\n" "input" "fast" "run" "ms" "lines/s"
+
+for input in echo comment; do
+	for fast in 0 1; do
+		for (( run = 1; run <= RUNS; run++ )); do
+			t0=$(date +%s%N)
+			QUASH_FAST_PARSE=$fast "$QUASH" < "$TMP/$input.in" \
+				> /dev/null 2>&1
+			t1=$(date +%s%N)
+
+			awk -v input="$input" -v fast="$fast" -v run="$run" \
+			    -v n="$LINES" -v t0="$t0" -v t1="$t1" \
+			    'BEGIN { ms = (t1 - t0) / 1e6
+			             printf "%8s %8d %8d %10.0f %10.0f\n", input,
+			                    fast, run, ms, n * 1e3 / ms }'
+		done
+	done
+done
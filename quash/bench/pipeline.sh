@@ -0,0 +1,43 @@
+#!/bin/bash
+#
+# Throughput of long pipelines
+#
+# Runs `cat < file | cat | ... | wc -c` through quash with 2, 8 and 64 stages
+# in all over a file of zeros. Every cat is /bin/cat so each stage is a
+# process of its own, whatever builtins quash has.
+#
+# usage: bench/pipeline.sh [quash] [MiB] [stages ...]
+
+QUASH=$(realpath "${1:-./quash}")
+MIB=${2:-256}
+shift $(( $# < 2 ? $# : 2 ))
+STAGES=${*:-2 8 64}
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+head -c "${MIB}M" /dev/zero > "$TMP/zeros"
+
+printf "%8s %10s %10s\n" "stages" "ms" "MiB/s"
+
+for n in $STAGES; do
+	line="/bin/cat < $TMP/zeros"
+	for (( i = 2; i < n; i++ )); do
+		line+=" | /bin/cat"
+	done
+	line+=" | wc -c"
+
+	out=$(printf "date +%%s%%N\n%s\ndate +%%s%%N\n" "$line" | "$QUASH" 2>&1)
+
+	bytes=$(grep -E '^[0-9]{1,15}$' <<< "$out")
+	times=($(grep -E '^[0-9]{10,}$' <<< "$out"))
+
+	if [ "$bytes" != $(( MIB << 20 )) ]; then
+		echo "$n stages: wc -c printed '$bytes'" >&2
+		continue
+	fi
+
+	awk -v n="$n" -v mb="$MIB" -v t0="${times[0]}" -v t1="${times[1]}" \
+	    'BEGIN { ms = (t1 - t0) / 1e6
+	             printf "%8d %10.0f %10.0f\n", n, ms, mb * 1e3 / ms }'
+done
@@ -0,0 +1,42 @@
+#!/bin/bash
+#
+# Spawns per second against the resident size of quash
+#
+# ballast.c is preloaded into quash to grow its heap to each size before it
+# starts. Quash then runs the same number of `true` commands at every size.
+# Starting a program with fork() gets slower as the parent grows, while
+# posix_spawn() should not.
+#
+# usage: bench/spawn_rss.sh [quash] [spawns] [MiB ...]
+
+QUASH=$(realpath "${1:-./quash}")
+SPAWNS=${2:-2000}
+shift $(( $# < 2 ? $# : 2 ))
+SIZES=${*:-0 64 256 1024}
+
+BENCH=$(dirname "$(realpath "$0")")
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+${CC:-cc} -shared -fPIC -o "$TMP/ballast.so" "$BENCH/ballast.c" || exit 1
+
+{
+	echo "sh -c 'grep VmRSS /proc/\$PPID/status'"
+	echo 'date +%s%N'
+	yes true | head -n "$SPAWNS"
+	echo 'date +%s%N'
+} > "$TMP/spawns.in"
+
+printf "%8s %10s %10s\n" "MiB" "rss KiB" "spawns/s"
+
+for mb in $SIZES; do
+	out=$(BALLAST_MIB=$mb LD_PRELOAD="$TMP/ballast.so" \
+	      "$QUASH" < "$TMP/spawns.in" 2>&1)
+
+	rss=$(awk '/^VmRSS/ { print $2 }' <<< "$out")
+	times=($(grep -E '^[0-9]{10,}$' <<< "$out"))
+
+	awk -v mb="$mb" -v rss="$rss" -v n="$SPAWNS" -v t0="${times[0]}" \
+	    -v t1="${times[1]}" \
+	    'BEGIN { printf "%8d %10d %10.0f\n", mb, rss, n * 1e9 / (t1 - t0) }'
+done
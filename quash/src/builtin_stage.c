@@ -0,0 +1,519 @@
+/**
+ * @file builtin_stage.c
+ *
+ * @brief Implements builtin pipeline stages that run inside quash
+ */
+
+#define _GNU_SOURCE
+
+#include "builtin_stage.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "execute.h"
+#include "trace.h"
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+/*
+ * @brief Everything a copying thread needs. The thread owns the descriptors.
+ */
+typedef struct CopyStage {
+	CommandType type;	/* CAT or TEE */
+	int in_fd;		/* Stage input */
+	int out_fd;		/* Stage output */
+	char** names;		/* Inputs of cat in order, NULL for stdin */
+	int* files;		/* Extra outputs of tee */
+	size_t num_files;	/* Number of entries in names or files */
+} CopyStage;
+
+/*
+ * @brief Output of a builtin that did not fit in its pipe
+ */
+typedef struct WriteStage {
+	char* buf;		/* Rendered output, freed by the thread */
+	size_t len;		/* Length of buf */
+	int fd;			/* Where it goes, closed by the thread */
+} WriteStage;
+
+// Threads started for the current pipeline
+static pthread_t* threads = NULL;
+static size_t num_threads = 0;
+static size_t threads_cap = 0;
+
+// Largest amount moved by one copy_file_range(), splice() or tee() call
+#define COPY_CHUNK (1 << 16)
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// Write a whole buffer, giving up if the reader went away
+static bool write_all(int fd, const char* buf, size_t len) {
+
+	while(len > 0){
+		ssize_t n = write(fd, buf, len);
+
+		if(n < 0){
+			if(EINTR == errno){
+				continue;
+			}
+			return false;
+		}
+
+		buf += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+
+// Copy with read() and write() when the kernel cannot do it for us
+static bool copy_through_buffer(int in, int out) {
+
+	char buf[COPY_CHUNK];
+	ssize_t n;
+
+	while(0 != (n = read(in, buf, sizeof(buf)))){
+		if(n < 0){
+			if(EINTR == errno){
+				continue;
+			}
+			return false;
+		}
+
+		if(!write_all(out, buf, n)){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+// Check if a descriptor is a pipe
+static bool is_pipe(int fd) {
+
+	struct stat st;
+
+	return 0 == fstat(fd, &st) && S_ISFIFO(st.st_mode);
+}
+
+
+// Check if a descriptor is a regular file
+static bool is_regular(int fd) {
+
+	struct stat st;
+
+	return 0 == fstat(fd, &st) && S_ISREG(st.st_mode);
+}
+
+
+// Copy everything from in to out, staying in the kernel where possible. Only
+// a failure of the very first call of a method means the method does not
+// apply to these descriptors.
+static bool copy_fd(int in, int out) {
+
+	ssize_t n;
+	bool moved = false;
+
+	// File to file copies can even be shared extents on some filesystems.
+	// Special files such as those in /proc report no size and are skipped.
+	if(is_regular(in) && is_regular(out)){
+		while((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0)) > 0){
+			moved = true;
+		}
+		if(0 == n){
+			return true;
+		}
+		if(moved || !(EINVAL == errno || EXDEV == errno || EBADF == errno ||
+			      ENOSYS == errno || EOPNOTSUPP == errno)){
+			return false;
+		}
+	}
+
+	// Anything to or from a pipe moves pages instead of bytes
+	while((n = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE)) > 0 ||
+	      (n < 0 && EINTR == errno)){
+		moved = true;
+	}
+	if(0 == n){
+		return true;
+	}
+	if(moved || EINVAL != errno){
+		return false;
+	}
+
+	return copy_through_buffer(in, out);
+}
+
+
+// Copy in to out and to every file
+static bool tee_fd(int in, int out, int* files, size_t num_files) {
+
+	if(0 == num_files){
+		return copy_fd(in, out);
+	}
+
+	// Pipe to pipe with a single file: duplicate the pages into out with
+	// tee() and then move the same pages into the file with splice()
+	if(1 == num_files && is_pipe(in) && is_pipe(out)){
+		ssize_t n;
+
+		while(0 != (n = tee(in, out, COPY_CHUNK, 0))){
+			if(n < 0){
+				if(EINTR == errno){
+					continue;
+				}
+				return false;
+			}
+
+			while(n > 0){
+				ssize_t m = splice(in, NULL, files[0], NULL, n, SPLICE_F_MOVE);
+
+				if(m < 0 && EINTR == errno){
+					continue;
+				}
+				if(m <= 0){
+					return false;
+				}
+				n -= m;
+			}
+		}
+
+		return true;
+	}
+
+	char buf[COPY_CHUNK];
+	ssize_t n;
+
+	while(0 != (n = read(in, buf, sizeof(buf)))){
+		if(n < 0){
+			if(EINTR == errno){
+				continue;
+			}
+			return false;
+		}
+
+		if(!write_all(out, buf, n)){
+			return false;
+		}
+
+		for(size_t i = 0; i < num_files; ++i){
+			write_all(files[i], buf, n);
+		}
+	}
+
+	return true;
+}
+
+
+// Close a descriptor unless it belongs to quash itself
+static void close_stage_fd(int fd) {
+
+	if(fd > STDERR_FILENO){
+		close(fd);
+	}
+}
+
+
+// Body of a cat or tee thread
+static void* copy_stage_main(void* arg) {
+
+	CopyStage* stage = arg;
+	bool ok = true;
+	double start = trace_begin();
+
+	if(CAT == stage->type){
+		// Each file is opened in turn, so an error shows up between
+		// the output of the files around it
+		for(size_t i = 0; ok && i < stage->num_files; ++i){
+			char* name = stage->names[i];
+			int fd = (NULL == name) ? stage->in_fd :
+				open(name, O_RDONLY | O_CLOEXEC);
+
+			if(fd < 0){
+				fprintf(stderr, "cat: %s: %s\n", name, strerror(errno));
+				continue;
+			}
+
+			ok = copy_fd(fd, stage->out_fd);
+
+			if(NULL != name){
+				close(fd);
+			}
+		}
+	}
+	else{
+		ok = tee_fd(stage->in_fd, stage->out_fd, stage->files,
+			    stage->num_files);
+	}
+
+	// A reader that stopped early is not worth a message
+	if(!ok && EPIPE != errno){
+		fprintf(stderr, "%s: %s\n", (CAT == stage->type) ? "cat" : "tee",
+			strerror(errno));
+	}
+
+	for(size_t i = 0; CAT == stage->type && i < stage->num_files; ++i){
+		free(stage->names[i]);
+	}
+
+	trace_end((CAT == stage->type) ? "cat" : "tee", start, 0, -1);
+
+	for(size_t i = 0; TEE == stage->type && i < stage->num_files; ++i){
+		close_stage_fd(stage->files[i]);
+	}
+
+	close_stage_fd(stage->in_fd);
+	close_stage_fd(stage->out_fd);
+
+	free(stage->names);
+	free(stage->files);
+	free(stage);
+
+	return NULL;
+}
+
+
+// Body of a thread feeding rendered output into a pipe
+static void* write_stage_main(void* arg) {
+
+	WriteStage* stage = arg;
+	double start = trace_begin();
+
+	write_all(stage->fd, stage->buf, stage->len);
+	trace_end("builtin output", start, 0, -1);
+
+	close_stage_fd(stage->fd);
+	free(stage->buf);
+	free(stage);
+
+	return NULL;
+}
+
+
+// Start a stage thread with every signal blocked so SIGCHLD is always
+// handled by the main thread
+static bool start_thread(void* (*func)(void*), void* arg) {
+
+	if(num_threads == threads_cap){
+		threads_cap = (0 == threads_cap) ? 4 : 2 * threads_cap;
+		threads = realloc(threads, threads_cap * sizeof(pthread_t));
+
+		if(NULL == threads){
+			fprintf(stderr, "ERROR: Failed to allocate the stage threads\n");
+			exit(-1);
+		}
+	}
+
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	int err = pthread_create(&threads[num_threads], NULL, func, arg);
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if(0 != err){
+		// Running the stage here could block on a pipe nobody reads yet
+		errno = err;
+		perror("ERROR: Failed to start pipeline stage");
+		return false;
+	}
+
+	++num_threads;
+	return true;
+}
+
+
+// Hand the files named by a cat or tee command to a thread that copies them
+static void start_copy_stage(Command cmd, int in_fd, int out_fd) {
+
+	char** args = cmd.generic.args;
+	size_t num_args = 0;
+	CommandType type = get_command_type(cmd);
+
+	while(NULL != args[num_args]){
+		++num_args;
+	}
+
+	CopyStage* stage = malloc(sizeof(CopyStage));
+	char** names = (CAT == type) ? malloc((num_args + 1) * sizeof(char*)) : NULL;
+	int* files = (TEE == type) ? malloc((num_args + 1) * sizeof(int)) : NULL;
+
+	if(NULL == stage || (NULL == names && NULL == files)){
+		fprintf(stderr, "ERROR: Failed to allocate a pipeline stage\n");
+		exit(-1);
+	}
+
+	*stage = (CopyStage) { type, in_fd, out_fd, names, files, 0 };
+
+	// The names live in the memory pool, which may be reset before the
+	// thread is done, so cat gets copies to open as it goes
+	if(CAT == type && 0 == num_args){
+		names[stage->num_files++] = NULL;
+	}
+
+	for(size_t i = 0; CAT == type && i < num_args; ++i){
+		char* name = NULL;
+
+		if(0 != strcmp(args[i], "-") && NULL == (name = strdup(args[i]))){
+			fprintf(stderr, "ERROR: Failed to allocate a pipeline stage\n");
+			exit(-1);
+		}
+
+		names[stage->num_files++] = name;
+	}
+
+	// Like tee(1), every output is opened before anything is copied
+	for(size_t i = 0; TEE == type && i < num_args; ++i){
+		int fd = open(args[i], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+		if(fd < 0){
+			fprintf(stderr, "tee: %s: %s\n", args[i], strerror(errno));
+			continue;
+		}
+
+		files[stage->num_files++] = fd;
+	}
+
+	if(!start_thread(copy_stage_main, stage)){
+		for(size_t i = 0; i < stage->num_files; ++i){
+			if(CAT == type){
+				free(names[i]);
+			}
+			else{
+				close_stage_fd(files[i]);
+			}
+		}
+
+		close_stage_fd(in_fd);
+		close_stage_fd(out_fd);
+		free(names);
+		free(files);
+		free(stage);
+	}
+}
+
+
+// Render the output of a printing builtin and send it to out_fd
+static void write_builtin_output(Command cmd, int out_fd) {
+
+	char* buf = NULL;
+	size_t len = 0;
+
+	// The builtins print to stdout, which glibc lets us point at memory
+	fflush(stdout);
+
+	FILE* saved = stdout;
+	FILE* mem = open_memstream(&buf, &len);
+
+	if(NULL == mem){
+		perror("ERROR: Failed to run builtin");
+		close_stage_fd(out_fd);
+		return;
+	}
+
+	stdout = mem;
+	child_run_command(cmd);
+	fclose(mem);
+	stdout = saved;
+
+	int fd = (out_fd < 0) ? STDOUT_FILENO : out_fd;
+	int cap = fcntl(fd, F_GETPIPE_SZ);
+	int queued = 0;
+
+	// Write it now unless it could block on a pipe that is too full
+	if(cap < 0 || (0 == ioctl(fd, FIONREAD, &queued) &&
+		       len <= (size_t) (cap - queued))){
+		write_all(fd, buf, len);
+		close_stage_fd(out_fd);
+		free(buf);
+		return;
+	}
+
+	WriteStage* stage = malloc(sizeof(WriteStage));
+
+	if(NULL == stage){
+		fprintf(stderr, "ERROR: Failed to allocate a pipeline stage\n");
+		exit(-1);
+	}
+
+	*stage = (WriteStage) { buf, len, fd };
+
+	if(!start_thread(write_stage_main, stage)){
+		close_stage_fd(out_fd);
+		free(buf);
+		free(stage);
+	}
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// cat and tee never fork, piped or not
+bool is_passthrough_builtin(CommandType type) {
+	return CAT == type || TEE == type;
+}
+
+
+// Run a builtin stage in quash
+void run_builtin_stage(Command cmd, int in_fd, int out_fd) {
+
+	switch(get_command_type(cmd)){
+	case CAT:
+	case TEE:
+		fflush(stdout);
+		start_copy_stage(cmd, (in_fd < 0) ? STDIN_FILENO : in_fd,
+				 (out_fd < 0) ? STDOUT_FILENO : out_fd);
+		return;
+
+	case ECHO:
+	case PWD:
+	case JOBS:
+	case HASH:
+		write_builtin_output(cmd, out_fd);
+		break;
+
+	default:
+		// Nothing to print, parent_run_command() does the rest
+		close_stage_fd(out_fd);
+		break;
+	}
+
+	// Printing builtins never read their input
+	close_stage_fd(in_fd);
+}
+
+
+// Join or detach the pipeline's threads
+void finish_builtin_stages(bool wait) {
+
+	for(size_t i = 0; i < num_threads; ++i){
+		if(wait){
+			pthread_join(threads[i], NULL);
+		}
+		else{
+			pthread_detach(threads[i]);
+		}
+	}
+
+	num_threads = 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file builtin_stage.h
+ *
+ * @brief Runs builtin pipeline stages inside quash instead of in a child
+ *
+ * Builtins that only print something (echo, pwd, jobs and hash) have their
+ * output rendered in memory and written straight into the next pipe. If the
+ * output fits in the space left in the pipe it is written immediately,
+ * otherwise a writer thread feeds it to the reader. The cat and tee builtins
+ * run on a thread of their own and move data with copy_file_range(),
+ * splice() and tee() so the bytes never pass through user space when the
+ * kernel can avoid it.
+ *
+ * Threads started for a pipeline are either waited on with the rest of a
+ * foreground job or detached for a background job.
+ */
+
+#ifndef SRC_BUILTIN_STAGE_H
+#define SRC_BUILTIN_STAGE_H
+
+#include <stdbool.h>
+
+#include "command.h"
+
+/**
+ * @brief Check if a command always runs inside quash
+ *
+ * @param type Type of the command
+ *
+ * @return True for builtins that are run with run_builtin_stage() even
+ * outside of a pipeline
+ */
+bool is_passthrough_builtin(CommandType type);
+
+/**
+ * @brief Run a builtin command as a pipeline stage without forking
+ *
+ * Builtins that change quash itself, such as cd, are not run here. Their
+ * stage simply closes its descriptors and parent_run_command() does the work.
+ *
+ * @param cmd The builtin command
+ *
+ * @param in_fd Descriptor the stage reads from, or -1 to use the stdin of
+ * quash. The stage takes ownership of it.
+ *
+ * @param out_fd Descriptor the stage writes to, or -1 to use the stdout of
+ * quash. The stage takes ownership of it.
+ */
+void run_builtin_stage(Command cmd, int in_fd, int out_fd);
+
+/**
+ * @brief Wait for or let go of every stage thread started since the last call
+ *
+ * @param wait True to block until the threads have finished, false to detach
+ * them
+ */
+void finish_builtin_stages(bool wait);
+
+#endif
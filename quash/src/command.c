@@ -99,11 +99,84 @@ Command mk_pwd_command() {
 }
 
 // Create JobCommand structure
-Command mk_jobs_command() {
+Command mk_jobs_command(bool long_format) {
   Command cmd;
 
   cmd.jobs = (JobsCommand) {
-    JOBS
+    JOBS,
+    long_format
+  };
+
+  return cmd;
+}
+
+// Create HashCommand structure
+Command mk_hash_command(char** args) {
+  Command cmd;
+
+  cmd.hash = (HashCommand) {
+    HASH,
+    args
+  };
+
+  return cmd;
+}
+
+// Create CatCommand structure
+Command mk_cat_command(char** args) {
+  Command cmd;
+
+  cmd.cat = (CatCommand) {
+    CAT,
+    args
+  };
+
+  return cmd;
+}
+
+// Create TeeCommand structure
+Command mk_tee_command(char** args) {
+  Command cmd;
+
+  cmd.tee = (TeeCommand) {
+    TEE,
+    args
+  };
+
+  return cmd;
+}
+
+// Create FgCommand structure
+Command mk_fg_command(char** args) {
+  Command cmd;
+
+  cmd.fg = (FgCommand) {
+    FG,
+    args
+  };
+
+  return cmd;
+}
+
+// Create BgCommand structure
+Command mk_bg_command(char** args) {
+  Command cmd;
+
+  cmd.bg = (BgCommand) {
+    BG,
+    args
+  };
+
+  return cmd;
+}
+
+// Create ParallelCommand structure
+Command mk_parallel_command(char** args) {
+  Command cmd;
+
+  cmd.parallel = (ParallelCommand) {
+    PARALLEL,
+    args
   };
 
   return cmd;
@@ -167,6 +240,36 @@ static void __print_kill_cmd(KillCommand cmd) {
   printf("%%KILL%% [JOB: %d] [SIG: %d]", cmd.sig, cmd.job);
 }
 
+static void __print_hash_cmd(HashCommand cmd) {
+  printf("%%HASH%% ");
+  __print_generic_cmd(cmd);
+}
+
+static void __print_cat_cmd(CatCommand cmd) {
+  printf("%%CAT%% ");
+  __print_generic_cmd(cmd);
+}
+
+static void __print_tee_cmd(TeeCommand cmd) {
+  printf("%%TEE%% ");
+  __print_generic_cmd(cmd);
+}
+
+static void __print_fg_cmd(FgCommand cmd) {
+  printf("%%FG%% ");
+  __print_generic_cmd(cmd);
+}
+
+static void __print_bg_cmd(BgCommand cmd) {
+  printf("%%BG%% ");
+  __print_generic_cmd(cmd);
+}
+
+static void __print_parallel_cmd(ParallelCommand cmd) {
+  printf("%%PARALLEL%% ");
+  __print_generic_cmd(cmd);
+}
+
 static void __print_simple_cmd(const char* str) {
   printf("%%%s%%", str);
 }
@@ -198,7 +301,31 @@ static void __print_command(Command cmd) {
     break;
 
   case JOBS:
-    __print_simple_cmd("JOBS");
+    __print_simple_cmd(cmd.jobs.long_format ? "JOBS -l" : "JOBS");
+    break;
+
+  case HASH:
+    __print_hash_cmd(cmd.hash);
+    break;
+
+  case CAT:
+    __print_cat_cmd(cmd.cat);
+    break;
+
+  case TEE:
+    __print_tee_cmd(cmd.tee);
+    break;
+
+  case FG:
+    __print_fg_cmd(cmd.fg);
+    break;
+
+  case BG:
+    __print_bg_cmd(cmd.bg);
+    break;
+
+  case PARALLEL:
+    __print_parallel_cmd(cmd.parallel);
     break;
 
   case EXIT:
@@ -226,6 +353,11 @@ static void __print_command_holder(CommandHolder holder) {
   else
     printf("FG ");
 
+  if (holder.flags & TIME_STAGES)
+    printf("TIME_V ");
+  else if (holder.flags & TIME_PIPELINE)
+    printf("TIME ");
+
   if (holder.flags & PIPE_IN)
     printf("P_IN ");
 
@@ -243,7 +375,7 @@ static void __print_command_holder(CommandHolder holder) {
   if (holder.flags & REDIRECT_OUT)
     printf("%s) ", holder.redirect_out);
 
-  printf("*0x%02x*", holder.flags);
+  printf("*0x%02x*", (unsigned char) holder.flags);
 
   printf(">");
 
@@ -45,12 +45,26 @@
  * @brief Flag bit indicating whether a @a GenericCommand should be run in
  * the background
  */
+/**
+ * @def TIME_PIPELINE
+ *
+ * @brief Flag bit set on the first @a CommandHolder of a pipeline run with
+ * the `time` prefix
+ */
+/**
+ * @def TIME_STAGES
+ *
+ * @brief Flag bit set on the first @a CommandHolder of a pipeline run with
+ * `time -v`, which also reports on each stage
+ */
 #define REDIRECT_IN     (0x01)
+#define TIME_PIPELINE   (0x02)
 #define REDIRECT_OUT    (0x04)
 #define REDIRECT_APPEND (0x08)
 #define PIPE_IN         (0x10)
 #define PIPE_OUT        (0x20)
 #define BACKGROUND      (0x40)
+#define TIME_STAGES     (0x80)
 
 /**
  * @brief All possible types of commands
@@ -69,7 +83,13 @@ typedef enum CommandType {
   CD,
   PWD,
   JOBS,
-  EXIT
+  EXIT,
+  HASH,
+  CAT,
+  TEE,
+  FG,
+  BG,
+  PARALLEL
 } CommandType;
 
 // Command Structures
@@ -154,11 +174,75 @@ typedef struct KillCommand {
 typedef SimpleCommand PWDCommand;
 
 /**
- * @brief Alias for @a SimpleCommand to denote a print jobs list
+ * @brief Command to print the jobs list
+ *
+ * @sa Command, Job
+ */
+typedef struct JobsCommand {
+  CommandType type; /**< Type of command */
+  bool long_format; /**< Also print the pid, state and resource usage of each
+                     * job (`jobs -l`) */
+} JobsCommand;
+
+/**
+ * @brief Alias for @a GenericCommand to denote a command that manages the table
+ * of resolved program paths
+ *
+ * @note The args array holds the arguments following the word `hash`
+ *
+ * @sa GenericCommand, Command
+ */
+typedef GenericCommand HashCommand;
+
+/**
+ * @brief Alias for @a GenericCommand to denote a copy of files or stdin to
+ * stdout that quash performs itself
+ *
+ * @note The args array holds the file names following the word `cat`
+ *
+ * @sa GenericCommand, Command
+ */
+typedef GenericCommand CatCommand;
+
+/**
+ * @brief Alias for @a GenericCommand to denote a copy of stdin to stdout and
+ * to files that quash performs itself
+ *
+ * @note The args array holds the file names following the word `tee`
+ *
+ * @sa GenericCommand, Command
+ */
+typedef GenericCommand TeeCommand;
+
+/**
+ * @brief Alias for @a GenericCommand to denote a command that brings a job to
+ * the foreground
+ *
+ * @note The args array holds the job id following the word `fg`, if any
+ *
+ * @sa GenericCommand, Command
+ */
+typedef GenericCommand FgCommand;
+
+/**
+ * @brief Alias for @a GenericCommand to denote a command that continues a
+ * stopped job in the background
  *
- * @sa SimpleCommand, Command, Job
+ * @note The args array holds the job id following the word `bg`, if any
+ *
+ * @sa GenericCommand, Command
  */
-typedef SimpleCommand JobsCommand;
+typedef GenericCommand BgCommand;
+
+/**
+ * @brief Alias for @a GenericCommand to denote a command that runs a program
+ * once per item with a bounded number of copies running at a time
+ *
+ * @note The args array holds the words following the word `parallel`
+ *
+ * @sa GenericCommand, Command, run_parallel()
+ */
+typedef GenericCommand ParallelCommand;
 
 /**
  * @brief Alias for @a SimpleCommand to denote a termination of the program
@@ -182,7 +266,8 @@ typedef SimpleCommand EOCCommand;
  * get_command_type() function.
  *
  * @sa get_command_type, SimpleCommand, GenericCommand, EchoCommand,
- * ExportCommand, CDCommand, KillCommand, PWDCommand, JobsCommand, ExitCommand,
+ * ExportCommand, CDCommand, KillCommand, PWDCommand, JobsCommand, HashCommand,
+ * CatCommand, TeeCommand, FgCommand, BgCommand, ParallelCommand, ExitCommand,
  * EOCCommand
  */
 typedef union Command {
@@ -194,6 +279,12 @@ typedef union Command {
   KillCommand kill;       /**< Read structure as a @a KillCommand */
   PWDCommand pwd;         /**< Read structure as a @a PWDCommand */
   JobsCommand jobs;       /**< Read structure as a @a JobsCommand */
+  HashCommand hash;       /**< Read structure as a @a HashCommand */
+  CatCommand cat;         /**< Read structure as a @a CatCommand */
+  TeeCommand tee;         /**< Read structure as a @a TeeCommand */
+  FgCommand fg;           /**< Read structure as a @a FgCommand */
+  BgCommand bg;           /**< Read structure as a @a BgCommand */
+  ParallelCommand parallel; /**< Read structure as a @a ParallelCommand */
   ExitCommand exit;       /**< Read structure as a @a ExitCommand */
   EOCCommand eoc;         /**< Read structure as a @a EOCCommand */
 } Command;
@@ -217,7 +308,9 @@ typedef struct CommandHolder {
                        *   - @a REDIRECT_APPEND
                        *   - @a PIPE_IN
                        *   - @a PIPE_OUT
-                       *   - @a BACKGROUND */
+                       *   - @a BACKGROUND
+                       *   - @a TIME_PIPELINE
+                       *   - @a TIME_STAGES */
   Command cmd;        /**< A @a Command to hold */
 } CommandHolder;
 
@@ -243,13 +336,15 @@ typedef struct CommandHolder {
  *   - @a PIPE_IN
  *   - @a PIPE_OUT
  *   - @a BACKGROUND
+ *   - @a TIME_PIPELINE
+ *   - @a TIME_STAGES
  *
  * @param cmd The @a Command the CommandHolder should copy and hold on to
  *
  * @return Copy of constructed CommandHolder
  *
  * @sa CommandType, REDIRECT_IN, REDIRECT_OUT, REDIRECT_APPEND, PIPE_IN, PIPE_OUT,
- * BACKGROUND, Command, CommandHolder
+ * BACKGROUND, TIME_PIPELINE, TIME_STAGES, Command, CommandHolder
  */
 CommandHolder mk_command_holder(char* redirect_in, char* redirect_out, char flags, Command cmd);
 
@@ -326,11 +421,84 @@ Command mk_pwd_command();
 /**
  * @brief Create a @a JobsCommand structure and return a copy
  *
+ * @param long_format True for `jobs -l`
+ *
  * @return Copy of constructed JobsCommand as a @a Command
  *
  * @sa Command, JobsCommand
  */
-Command mk_jobs_command();
+Command mk_jobs_command(bool long_format);
+
+/**
+ * @brief Create a @a HashCommand structure and return a copy
+ *
+ * @param args A NULL terminated array of strings holding the options and
+ * program names passed to hash
+ *
+ * @return Copy of constructed HashCommand as a @a Command
+ *
+ * @sa Command, HashCommand
+ */
+Command mk_hash_command(char** args);
+
+/**
+ * @brief Create a @a CatCommand structure and return a copy
+ *
+ * @param args A NULL terminated array of the files to copy. An empty array or
+ * a file named "-" stands for stdin.
+ *
+ * @return Copy of constructed CatCommand as a @a Command
+ *
+ * @sa Command, CatCommand
+ */
+Command mk_cat_command(char** args);
+
+/**
+ * @brief Create a @a TeeCommand structure and return a copy
+ *
+ * @param args A NULL terminated array of the files to write stdin to
+ *
+ * @return Copy of constructed TeeCommand as a @a Command
+ *
+ * @sa Command, TeeCommand
+ */
+Command mk_tee_command(char** args);
+
+/**
+ * @brief Create a @a FgCommand structure and return a copy
+ *
+ * @param args A NULL terminated array holding the job id, or nothing for the
+ * most recent job
+ *
+ * @return Copy of constructed FgCommand as a @a Command
+ *
+ * @sa Command, FgCommand
+ */
+Command mk_fg_command(char** args);
+
+/**
+ * @brief Create a @a BgCommand structure and return a copy
+ *
+ * @param args A NULL terminated array holding the job id, or nothing for the
+ * most recent job
+ *
+ * @return Copy of constructed BgCommand as a @a Command
+ *
+ * @sa Command, BgCommand
+ */
+Command mk_bg_command(char** args);
+
+/**
+ * @brief Create a @a ParallelCommand structure and return a copy
+ *
+ * @param args A NULL terminated array of the options, the command and the
+ * items passed to parallel
+ *
+ * @return Copy of constructed ParallelCommand as a @a Command
+ *
+ * @sa Command, ParallelCommand
+ */
+Command mk_parallel_command(char** args);
 
 /**
  * @brief Create a @a ExitCommand structure and return a copy
@@ -11,6 +11,56 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Round a requested deque capacity up to a power of two
+ *
+ * Deque capacities are always powers of two so an index can be wrapped with a
+ * mask instead of a division.
+ *
+ * @param cap The requested capacity
+ *
+ * @return The smallest power of two that is at least @a cap
+ */
+static inline size_t __deque_capacity(size_t cap) {
+  size_t ret = 1;
+
+  while (ret < cap)
+    ret <<= 1;
+
+  return ret;
+}
+
+/**
+ * @brief Copy the elements of a ring buffer to the start of another array
+ *
+ * The elements occupy at most two contiguous runs, the one starting at @a
+ * front and the one wrapped around to the start of @a src, so the copy is at
+ * most two calls to memcpy.
+ *
+ * @param dst Array to copy the elements to
+ *
+ * @param src The ring buffer
+ *
+ * @param front Index of the first element in @a src
+ *
+ * @param len Number of elements
+ *
+ * @param cap Capacity of @a src in elements
+ *
+ * @param size Size of one element
+ */
+static inline void __deque_unwrap(void* dst, const void* src, size_t front,
+                                  size_t len, size_t cap, size_t size) {
+  size_t first = cap - front;
+
+  if (first > len)
+    first = len;
+
+  memcpy(dst, (const char*) src + front * size, first * size);
+  memcpy((char*) dst + first * size, src, (len - first) * size);
+}
 
 /**
  * @def IMPLEMENT_DEQUE_STRUCT(struct_name, type)
@@ -98,7 +148,7 @@
     struct_name ret;                                                    \
                                                                         \
     if (init_cap > 0)                                                   \
-      ret.cap = init_cap;                                               \
+      ret.cap = __deque_capacity(init_cap);                             \
     else                                                                \
       ret.cap = 1;                                                      \
                                                                         \
@@ -158,7 +208,7 @@
   size_t length_##struct_name(struct_name* deq) {                       \
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
-    return (deq->back - deq->front + deq->cap) % deq->cap;              \
+    return (deq->back - deq->front) & (deq->cap - 1);                   \
   }                                                                     \
                                                                         \
   static void __reallign_##struct_name(struct_name* deq) {              \
@@ -177,15 +227,13 @@
         abort();                                                        \
       }                                                                 \
                                                                         \
-      size_t i;                                                         \
-                                                                        \
-      for (i = 0; i < len; ++i)                                         \
-        deq->data[i] = old_data[(deq->front + i) % deq->cap];           \
+      __deque_unwrap(deq->data, old_data, deq->front, len, deq->cap,    \
+                     sizeof(type));                                     \
                                                                         \
       free(old_data);                                                   \
                                                                         \
       deq->front = 0;                                                   \
-      deq->back = i;                                                    \
+      deq->back = len;                                                  \
     }                                                                   \
   }                                                                     \
                                                                         \
@@ -213,12 +261,12 @@
     size_t len = length_##struct_name(deq);                             \
                                                                         \
     for (size_t i = 0; i < len; ++i) {                                  \
-      func(deq->data[(deq->front + i) % deq->cap]);                     \
+      func(deq->data[(deq->front + i) & (deq->cap - 1)]);               \
     }                                                                   \
   }                                                                     \
                                                                         \
   static void __on_push_##struct_name(struct_name* deq) {               \
-    if (deq->front == (deq->back + 1) % deq->cap) {                     \
+    if (deq->front == ((deq->back + 1) & (deq->cap - 1))) {             \
       type* old_data = deq->data;                                       \
       size_t old_cap = deq->cap;                                        \
                                                                         \
@@ -231,15 +279,13 @@
         abort();                                                        \
       }                                                                 \
                                                                         \
-      size_t i;                                                         \
-                                                                        \
-      for (i = 0; i < old_cap - 1; ++i)                                 \
-        deq->data[i] = old_data[(deq->front + i) % old_cap];            \
+      __deque_unwrap(deq->data, old_data, deq->front, old_cap - 1,      \
+                     old_cap, sizeof(type));                            \
                                                                         \
       free(old_data);                                                   \
                                                                         \
       deq->front = 0;                                                   \
-      deq->back = i;                                                    \
+      deq->back = old_cap - 1;                                          \
     }                                                                   \
   }                                                                     \
                                                                         \
@@ -255,7 +301,7 @@
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_push_##struct_name(deq);                                       \
-    deq->front = (deq->front + deq->cap - 1) % deq->cap;                \
+    deq->front = (deq->front - 1) & (deq->cap - 1);                     \
     deq->data[deq->front] = element;                                    \
   }                                                                     \
                                                                         \
@@ -264,7 +310,7 @@
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_push_##struct_name(deq);                                       \
     deq->data[deq->back] = element;                                     \
-    deq->back = (deq->back + 1) % deq->cap;                             \
+    deq->back = (deq->back + 1) & (deq->cap - 1);                       \
   }                                                                     \
                                                                         \
   type pop_front_##struct_name(struct_name* deq) {                      \
@@ -272,7 +318,7 @@
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_pop_##struct_name(deq);                                        \
     size_t old_front = deq->front;                                      \
-    deq->front = (deq->front + 1) % deq->cap;                           \
+    deq->front = (deq->front + 1) & (deq->cap - 1);                     \
     return deq->data[old_front];                                        \
   }                                                                     \
                                                                         \
@@ -280,7 +326,7 @@
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_pop_##struct_name(deq);                                        \
-    deq->back = (deq->back + deq->cap - 1) % deq->cap;                  \
+    deq->back = (deq->back - 1) & (deq->cap - 1);                       \
     return deq->data[deq->back];                                        \
   }                                                                     \
                                                                         \
@@ -295,7 +341,7 @@
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     assert(!is_empty_##struct_name(deq));                               \
-    return deq->data[(deq->back + deq->cap - 1) % deq->cap];            \
+    return deq->data[(deq->back - 1) & (deq->cap - 1)];                 \
   }                                                                     \
                                                                         \
   void update_front_##struct_name(struct_name* deq, type element) {     \
@@ -309,7 +355,7 @@
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     assert(!is_empty_##struct_name(deq));                               \
-    deq->data[(deq->back + deq->cap - 1) % deq->cap] = element;         \
+    deq->data[(deq->back - 1) & (deq->cap - 1)] = element;              \
   }                                                                     \
                                                                         \
   void update_and_destroy_front_##struct_name(struct_name* deq,         \
@@ -332,7 +378,7 @@
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     assert(!is_empty_##struct_name(deq));                               \
                                                                         \
-    size_t idx = (deq->back + deq->cap - 1) % deq->cap;                 \
+    size_t idx = (deq->back - 1) & (deq->cap - 1);                      \
                                                                         \
     if (deq->destructor != NULL)                                        \
       deq->destructor(deq->data[idx]);                                  \
@@ -361,7 +407,8 @@ typedef char Type;
 // IMPLEMENT_DEQUE_STRUCT(Example, Type);
 typedef struct Example {
   Type* data;   /**< The array holding the deque */
-  size_t cap;   /**< The current capacity of the deque */
+  size_t cap;   /**< The current capacity of the deque. Always a power of
+                 *  two so indices wrap with a mask. */
   size_t front; /**< The index of the element at the front of the deque */
   size_t back;  /**< The index one greater than the last element of the queue */
 
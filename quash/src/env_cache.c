@@ -0,0 +1,205 @@
+/**
+ * @file env_cache.c
+ *
+ * @brief Implements the shadow environment used by lookup_env() and `$VAR`
+ * expansion
+ */
+
+#include "env_cache.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+/*
+ * @brief A single environment variable
+ */
+typedef struct EnvEntry {
+	char* name;	/* Variable name, NULL if the slot is free */
+	size_t name_len;	/* Length of name */
+	char* val;	/* Value of the variable */
+	size_t val_len;	/* Length of val */
+} EnvEntry;
+
+// Open addressing table, the capacity is always a power of two
+static EnvEntry* table = NULL;
+static size_t table_cap = 0;
+static size_t table_len = 0;
+
+// Set once environ has been copied into the table
+static bool loaded = false;
+
+// Initial number of slots in the table
+#define INITIAL_CAP 128
+
+extern char** environ;
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// FNV-1a hash of a variable name
+static size_t hash_name(const char* name, size_t len) {
+
+	uint64_t h = 14695981039346656037ULL;
+
+	for(size_t i = 0; i < len; ++i){
+		h ^= (unsigned char) name[i];
+		h *= 1099511628211ULL;
+	}
+
+	return (size_t) h;
+}
+
+
+// Find the slot holding name, or the free slot it belongs in
+static EnvEntry* find_slot(const char* name, size_t len) {
+
+	size_t mask = table_cap - 1;
+	size_t i = hash_name(name, len) & mask;
+
+	while(NULL != table[i].name &&
+	      (table[i].name_len != len || 0 != memcmp(table[i].name, name, len))){
+		i = (i + 1) & mask;
+	}
+
+	return &table[i];
+}
+
+
+// Double the table once it is three quarters full
+static void grow_table() {
+
+	EnvEntry* old = table;
+	size_t old_cap = table_cap;
+
+	table_cap = (0 == old_cap) ? INITIAL_CAP : 2 * old_cap;
+	table = calloc(table_cap, sizeof(EnvEntry));
+
+	if(NULL == table){
+		fprintf(stderr, "ERROR: Failed to allocate the environment cache\n");
+		exit(-1);
+	}
+
+	for(size_t i = 0; i < old_cap; ++i){
+		if(NULL != old[i].name){
+			*find_slot(old[i].name, old[i].name_len) = old[i];
+		}
+	}
+
+	free(old);
+}
+
+
+// Store a copy of a variable, replacing any previous value
+static void store(const char* name, size_t name_len, const char* val) {
+
+	if(4 * (table_len + 1) > 3 * table_cap){
+		grow_table();
+	}
+
+	EnvEntry* entry = find_slot(name, name_len);
+	size_t val_len = strlen(val);
+	char* copy = malloc(val_len + 1);
+
+	if(NULL == copy){
+		fprintf(stderr, "ERROR: Failed to allocate the environment cache\n");
+		exit(-1);
+	}
+
+	memcpy(copy, val, val_len + 1);
+
+	if(NULL == entry->name){
+		entry->name = strndup(name, name_len);
+		entry->name_len = name_len;
+		++table_len;
+	}
+
+	free(entry->val);
+	entry->val = copy;
+	entry->val_len = val_len;
+}
+
+
+// Copy environ into the table the first time a variable is needed
+static void load() {
+
+	loaded = true;
+
+	if(0 == table_cap){
+		grow_table();
+	}
+
+	for(char** env = environ; NULL != env && NULL != *env; ++env){
+		const char* eq = strchr(*env, '=');
+
+		if(NULL != eq){
+			// Like getenv(), the first definition of a name wins
+			EnvEntry* entry = find_slot(*env, eq - *env);
+
+			if(NULL == entry->name){
+				store(*env, eq - *env, eq + 1);
+			}
+		}
+	}
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Find a variable by name and length
+const char* env_cache_lookup(const char* name, size_t name_len,
+                             size_t* val_len) {
+
+	if(!loaded){
+		load();
+	}
+
+	EnvEntry* entry = find_slot(name, name_len);
+
+	if(NULL == entry->name){
+		return NULL;
+	}
+
+	if(NULL != val_len){
+		*val_len = entry->val_len;
+	}
+
+	return entry->val;
+}
+
+
+// Keep the table in step with setenv()
+void env_cache_set(const char* name, const char* val) {
+
+	if(!loaded){
+		load();
+	}
+
+	store(name, strlen(name), val);
+}
+
+
+// Free every entry
+void destroy_env_cache() {
+
+	for(size_t i = 0; i < table_cap; ++i){
+		free(table[i].name);
+		free(table[i].val);
+	}
+
+	free(table);
+	table = NULL;
+	table_cap = table_len = 0;
+	loaded = false;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file env_cache.h
+ *
+ * @brief A hash indexed copy of the environment used for variable expansion
+ *
+ * getenv() walks environ comparing every entry, and needs a NUL terminated
+ * name. The environment cache loads environ into a hash table once so a
+ * `$VAR` reference can be looked up straight from the command line by name
+ * and length. Quash changes its environment only through write_env(), which
+ * keeps the cache in sync.
+ */
+
+#ifndef SRC_ENV_CACHE_H
+#define SRC_ENV_CACHE_H
+
+#include <stddef.h>
+
+/**
+ * @brief Look up an environment variable
+ *
+ * @param name Name of the variable. It does not need to be NUL terminated.
+ *
+ * @param name_len Length of @a name
+ *
+ * @param[out] val_len Set to the length of the value if it is not NULL and
+ * the variable exists
+ *
+ * @return The value of the variable, or NULL if it is not set. The string is
+ * owned by the cache and stays valid until the variable is set again.
+ */
+const char* env_cache_lookup(const char* name, size_t name_len,
+                             size_t* val_len);
+
+/**
+ * @brief Record the new value of an environment variable
+ *
+ * Only updates the cache. Use write_env() to change the environment itself.
+ *
+ * @param name Name of the variable
+ *
+ * @param val The new value
+ *
+ * @sa write_env()
+ */
+void env_cache_set(const char* name, const char* val);
+
+/**
+ * @brief Free all memory held by the environment cache
+ */
+void destroy_env_cache();
+
+#endif
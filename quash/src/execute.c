@@ -6,9 +6,27 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include "execute.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include "builtin_stage.h"
+#include "env_cache.h"
+#include "job_table.h"
+#include "parallel.h"
+#include "path_cache.h"
+#include "prompt.h"
 #include "quash.h"
+#include "reaper.h"
+#include "trace.h"
 
 
 
@@ -16,17 +34,44 @@
  * Globals
  ***************************************************************************/
 
-// Global job queue handle
-// Used to track background job structs between calls
-static job_queue bg_q;
+// Ids of background jobs whose processes have all exited, in the order
+// they finished. A pid_queue is simply a queue of ints.
+static pid_queue done_jobs;
 
 // Flag such that above is only initialized once
 static int first_time = true;
 
-// Global pipe handles and tracking, used in create_process()
-static int env_pipes[2][2];
-static int in_pipe = -1;
-static int out_pipe = 0;
+// The job run_script() is waiting on, NULL while nothing runs in the
+// foreground
+static job_struct* fg_job = NULL;
+
+// Pipes between the stages of the pipeline being started, used in
+// create_process(). Stage i reads from pipes[i - 1] and writes to pipes[i].
+static int (*pipes)[2] = NULL;
+static size_t num_pipes = 0;
+
+/*
+ * @brief A stage of a pipeline run with `time -v`
+ */
+typedef struct TimedStage {
+	pid_t pid;		   /* Process running the stage, -1 for builtins */
+	bool exited;		   /* Whether the fields below are filled in */
+	struct timespec started;   /* When the stage was started */
+	struct timespec finished;  /* When the stage was reaped */
+	struct rusage usage;	   /* Resources the process used */
+} TimedStage;
+
+// Stages of the foreground pipeline run with `time -v`, NULL for any other
+// pipeline
+static TimedStage* timed_stages = NULL;
+static size_t num_timed_stages = 0;
+
+// Signal mask quash had before SIGCHLD was blocked for starting a pipeline,
+// which is the mask its children start with
+static sigset_t child_sigmask;
+
+// Environment handed to programs started with posix_spawn()
+extern char** environ;
 
 
 /****************************************************************************
@@ -34,30 +79,20 @@ static int out_pipe = 0;
  ***************************************************************************/
 
 /*
- * @brief Frees memory for the background queue on exit
+ * @brief Frees memory for the background jobs on exit
  *
  * signalled upstream from quash.c on exit condition
  *
  */
 void free_background_queue(){
 	
-	assert(is_empty_job_queue(&bg_q));
+	assert(0 == job_table_length());
 	
 	if(first_time != true){
-		destroy_job_queue(&bg_q);
+		destroy_pid_queue(&done_jobs);
 	}
-}
-
 
-/*
- * @brief Destructor for job_structs
- *
- * @note 	This is passed to the deque data structure in place of the
- * 		default destructor
- */
-void destroy_struct(job_struct job){
-	free(job.command);
-	destroy_pid_queue(&job.process_q);
+	destroy_job_table();
 }
 
 
@@ -90,66 +125,422 @@ char* get_current_directory(bool* should_free) {
 // Returns the value of an environment variable env_var
 const char* lookup_env(const char* env_var) {
 
-	return getenv(env_var);
+	return env_cache_lookup(env_var, strlen(env_var), NULL);
 
 }
 
 
-// Check the status of background jobs
-void check_jobs_bg_status() {
+// Sets an environment variable and keeps the expansion cache in step
+void write_env(const char* env_var, const char* val) {
+
+	if(0 != setenv(env_var, val, 1)){
+		fprintf(stderr, "ERROR: Failed to update %s: %s\n", env_var,
+		        strerror(errno));
+		return;
+	}
+
+	env_cache_set(env_var, val);
+}
+
+
+// Seconds from one point in time to another
+static double elapsed(struct timespec from, struct timespec to) {
+	return (to.tv_sec - from.tv_sec) + (to.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+
+// Seconds held in a timeval
+static double timeval_seconds(struct timeval tv) {
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
 
-	int active, num_pids, num_jobs, status, still_running = 0;
-        job_struct temp_job_struct;
 
-	num_jobs = length_job_queue(&bg_q);
+// Keep the usage of a process of the pipeline being timed. Builtins that
+// start processes of their own wait on them from the foreground as well,
+// which are not stages and are not found.
+static void record_timed_stage(ExitRecord rec) {
 
-	if(0 == num_jobs){
-		return;	
+	for(size_t i = 0; i < num_timed_stages; ++i){
+		if(timed_stages[i].pid == rec.pid){
+			clock_gettime(CLOCK_MONOTONIC, &timed_stages[i].finished);
+			timed_stages[i].usage = rec.usage;
+			timed_stages[i].exited = true;
+			return;
+		}
 	}
+}
 
-	for(int k = 0; k<num_jobs; k++){
-		
-		temp_job_struct = pop_front_job_queue(&bg_q);
-		pid_queue *temp_q = &(temp_job_struct.process_q);
-		num_pids = length_pid_queue(temp_q);
-		
-		for(int i = 0; i<num_pids; ++i){
 
-			active = pop_front_pid_queue(temp_q);
-			
-			// If any given process in the job returns a zero
-			// value, then it is still running and we know the
-			// job is still active.
-			if(waitpid(active, &status, WNOHANG)==0) {
-
-				// If we make it here, then at least one
-				// process is still active (status 0 indicates
-				// unchanged from initial running status).
-				// Put the pid back where it was and the job
-				// struct back where it was
-				still_running = 1;
-				push_back_pid_queue(temp_q, active);
-				break;
+// Print what `time` reports once a pipeline has finished. The totals hold
+// the processes of the job and the time quash itself spent on the line,
+// which includes the stages it ran.
+static void report_time(const CommandHolder* holders, job_struct* job,
+			const struct rusage* self_before) {
+
+	struct timespec now;
+	struct rusage self;
+	struct timeval utime, stime;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	getrusage(RUSAGE_SELF, &self);
+
+	timersub(&self.ru_utime, &self_before->ru_utime, &utime);
+	timersub(&self.ru_stime, &self_before->ru_stime, &stime);
+	timeradd(&utime, &job->utime, &utime);
+	timeradd(&stime, &job->stime, &stime);
+
+	for(size_t i = 0; i < num_timed_stages; ++i){
+		TimedStage* stage = &timed_stages[i];
+
+		if(!stage->exited){
+			fprintf(stderr, "stage %zu\t%s\n", i + 1,
+				(GENERIC == get_command_holder_type(holders[i])) ?
+				"not started" : "ran inside quash");
+			continue;
+		}
+
+		fprintf(stderr, "stage %zu\tpid %d\treal %.6fs\tuser %.6fs\t"
+			"sys %.6fs\tmaxrss %ldK\n", i + 1, stage->pid,
+			elapsed(stage->started, stage->finished),
+			timeval_seconds(stage->usage.ru_utime),
+			timeval_seconds(stage->usage.ru_stime),
+			stage->usage.ru_maxrss);
+	}
+
+	fprintf(stderr, "real\t%.6fs\nuser\t%.6fs\nsys\t%.6fs\n",
+		elapsed(job->started, now), timeval_seconds(utime),
+		timeval_seconds(stime));
+}
+
+
+// Account for a child that the reaper has collected, or that was stopped or
+// continued by a signal
+static void handle_exit_record(ExitRecord rec) {
+
+	int job_id = find_job_id_by_pid(rec.pid);
+
+	if(job_id < 0){
+		return;
+	}
+
+	job_struct* job = (FOREGROUND_JOB_ID == job_id) ? fg_job : find_job(job_id);
+
+	trace_instant(WIFSTOPPED(rec.status) ? "stopped" :
+		      WIFCONTINUED(rec.status) ? "continued" : "exited",
+		      rec.pid, job_id);
+
+	if(WIFSTOPPED(rec.status)){
+		int sig = WSTOPSIG(rec.status);
+
+		// A foreground stage may read from the terminal before quash has
+		// handed it over, which is no reason to stop the job
+		if(FOREGROUND_JOB_ID == job_id && is_tty() &&
+		   (SIGTTIN == sig || SIGTTOU == sig)){
+			kill(rec.pid, SIGCONT);
+			return;
+		}
+
+		if(!set_pid_stopped(rec.pid, true)){
+			++job->num_stopped;
+		}
+		return;
+	}
+
+	// Continued or gone, the process is not stopped anymore
+	if(set_pid_stopped(rec.pid, false)){
+		--job->num_stopped;
+	}
+
+	if(WIFCONTINUED(rec.status)){
+		return;
+	}
+
+	// A pid only exits once, and may be reused by a later process
+	unindex_pid(rec.pid);
+
+	timeradd(&job->utime, &rec.usage.ru_utime, &job->utime);
+	timeradd(&job->stime, &rec.usage.ru_stime, &job->stime);
+
+	if(rec.usage.ru_maxrss > job->maxrss){
+		job->maxrss = rec.usage.ru_maxrss;
+	}
+
+	// The last stage decides the status of a pipeline
+	if(rec.pid == peek_back_pid_queue(&job->process_q)){
+		job->status = rec.status;
+	}
+
+	if(NULL != timed_stages && FOREGROUND_JOB_ID == job_id){
+		record_timed_stage(rec);
+	}
+
+	if(0 == --job->num_running){
+		clock_gettime(CLOCK_MONOTONIC, &job->finished);
+
+		if(FOREGROUND_JOB_ID != job_id){
+			push_back_pid_queue(&done_jobs, job_id);
+		}
+	}
+}
+
+
+// Move the processes of a job that have not exited to another job id
+static void reindex_job(job_struct* job, int from_id, int to_id) {
+
+	pid_queue* q = &job->process_q;
+	size_t len = length_pid_queue(q);
+
+	for(size_t i = 0; i < len; ++i){
+		int pid = pop_front_pid_queue(q);
+		if(from_id == find_job_id_by_pid(pid)){
+			index_pid(pid, to_id);
+		}
+		push_back_pid_queue(q, pid);
+	}
+}
+
+
+// Resume every stopped process of a job indexed under job_id
+static void continue_job(job_struct* job, int job_id) {
+
+	if(0 == job->num_stopped){
+		return;
+	}
+
+	// The continued records that follow find the flags already cleared
+	pid_queue* q = &job->process_q;
+	size_t len = length_pid_queue(q);
+
+	for(size_t i = 0; i < len; ++i){
+		int pid = pop_front_pid_queue(q);
+		if(job_id == find_job_id_by_pid(pid)){
+			if(set_pid_stopped(pid, false) && job->pgid <= 0){
+				kill(pid, SIGCONT);
 			}
-			else{
-				still_running = 0;	
+		}
+		push_back_pid_queue(q, pid);
+	}
+
+	job->num_stopped = 0;
+
+	if(job->pgid > 0){
+		killpg(job->pgid, SIGCONT);
+	}
+}
+
+
+// Send a signal to every process of a job
+void signal_job(job_struct* job, int job_id, int sig) {
+
+	// Every process of the job shares its process group, as does anything
+	// they started, so one call reaches all of them
+	if(job->pgid > 0){
+		killpg(job->pgid, sig);
+	}
+	else{
+		pid_queue* q = &job->process_q;
+		size_t len = length_pid_queue(q);
+
+		for(size_t i = 0; i < len; ++i){
+			int pid = pop_front_pid_queue(q);
+			if(job_id == find_job_id_by_pid(pid)){
+				kill(pid, sig);
 			}
+			push_back_pid_queue(q, pid);
 		}
+	}
 
-		// Print completion message
-	 	if(!still_running){
-			
-			print_job_bg_complete(temp_job_struct.job_id, active, temp_job_struct.command);
+	// Stopped processes only act on these once they run again
+	if(SIGTERM == sig || SIGHUP == sig || SIGKILL == sig){
+		continue_job(job, job_id);
+	}
+}
+
+
+// Hand the terminal to the process group of a foreground job
+static void give_terminal(pid_t pgid) {
+
+	if(is_tty() && pgid > 0){
+		tcsetpgrp(STDIN_FILENO, pgid);
+	}
+}
+
+
+// Wait until every process of the foreground job has exited or stopped
+static void wait_for_fg_job(job_struct* job) {
+
+	// The reaper collects children for us, so we only have to count them
+	// off as their records arrive. Records for background jobs that show
+	// up in the meantime are accounted for as well.
+	double start = trace_begin();
+	fg_job = job;
+
+	while(job->num_running > job->num_stopped){
+		ExitRecord rec;
+
+		// Block until some child exits or stops
+		reaper_wait(&rec);
+		handle_exit_record(rec);
+	}
+
+	fg_job = NULL;
+	trace_end("wait", start, 0, job->job_id);
+
+	// Take the terminal back from the job
+	if(job->pgid > 0){
+		give_terminal(getpgrp());
+	}
+}
+
+
+// Wait for the next process of a foreground job to exit
+pid_t wait_for_job_exit(job_struct* job, int* status) {
+
+	// Builtins that start processes wait from inside run_script(), which
+	// blocks SIGCHLD while it starts the line
+	sigset_t mask;
+	pthread_sigmask(SIG_SETMASK, &child_sigmask, &mask);
+
+	pid_t pid = -1;
+	double start = trace_begin();
+	fg_job = job;
 
-			// Clean up the completed job
-			destroy_pid_queue(&temp_job_struct.process_q);
-			free(temp_job_struct.command);
+	while(pid < 0 && job->num_running > job->num_stopped){
+		ExitRecord rec;
+
+		reaper_wait(&rec);
+
+		bool is_fg = FOREGROUND_JOB_ID == find_job_id_by_pid(rec.pid);
+		handle_exit_record(rec);
+
+		if(is_fg && !WIFSTOPPED(rec.status) && !WIFCONTINUED(rec.status)){
+			pid = rec.pid;
+			*status = rec.status;
 		}
-		else{
-			// Need to put it back
-			push_back_job_queue(&bg_q, temp_job_struct);
+	}
+
+	fg_job = NULL;
+	trace_end("wait", start, pid, job->job_id);
+
+	// Nothing of the job is left running. Its process group is gone
+	// as well once every process has exited.
+	if(job->num_running == job->num_stopped && job->pgid > 0){
+		give_terminal(getpgrp());
+
+		if(0 == job->num_running){
+			job->pgid = 0;
 		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+	return pid;
+}
+
+
+// Store a foreground job that was stopped in the job table
+static void stop_fg_job(job_struct* job, int job_id) {
+
+	reindex_job(job, FOREGROUND_JOB_ID, job_id);
+	job->job_id = job_id;
+
+	add_job(*job);
+	print_job_stopped(job_id, peek_front_pid_queue(&job->process_q),
+			  job->command);
+}
 
+
+// Take control of the terminal so it can be handed to jobs and back
+void initialize_job_control() {
+
+	// Wait until we are in the foreground if we were started in the
+	// background of another shell
+	pid_t fg;
+	while(0 <= (fg = tcgetpgrp(STDIN_FILENO)) && fg != getpgrp()){
+		kill(-getpgrp(), SIGTTIN);
+	}
+
+	// Neither Ctrl-Z at the prompt nor taking the terminal back from a job
+	// may stop quash. Children get the default dispositions back.
+	signal(SIGTSTP, SIG_IGN);
+	signal(SIGTTIN, SIG_IGN);
+	signal(SIGTTOU, SIG_IGN);
+
+	// Lead a process group of our own so it can be told apart from jobs
+	if(getpid() != getpgrp() && 0 == setpgid(0, 0)){
+		tcsetpgrp(STDIN_FILENO, getpgrp());
+	}
+}
+
+
+// Prints the resources used by the processes of a job that have exited and
+// how long it has been running
+static void print_job_usage(job_struct* job) {
+
+	struct timespec end = job->finished;
+
+	if(0 < job->num_running){
+		clock_gettime(CLOCK_MONOTONIC, &end);
+	}
+
+	double wall = elapsed(job->started, end);
+
+	printf("user %ld.%03lds sys %ld.%03lds maxrss %ldK wall %.3fs",
+	       (long) job->utime.tv_sec, (long) job->utime.tv_usec / 1000,
+	       (long) job->stime.tv_sec, (long) job->stime.tv_usec / 1000,
+	       job->maxrss, wall);
+
+	if(-1 == job->status){
+		return;
+	}
+
+	if(WIFSIGNALED(job->status)){
+		printf(" signal %d", WTERMSIG(job->status));
+	}
+	else{
+		printf(" exit %d", WEXITSTATUS(job->status));
+	}
+}
+
+
+// Check the status of background jobs
+void check_jobs_bg_status() {
+
+	ExitRecord rec;
+
+	// Children have already been reaped, we only need to catch up on the
+	// records of the ones that exited since we last looked
+	while(reaper_poll(&rec)){
+		handle_exit_record(rec);
+	}
+
+	// Resource usage follows the completion message if it was asked for
+	bool show_usage = false;
+
+	if(!is_empty_pid_queue(&done_jobs)){
+		const char* env = lookup_env("QUASH_JOB_STATS");
+		show_usage = NULL != env && '\0' != *env && 0 != strcmp(env, "0");
+	}
+
+	// Only jobs that have finished need to be looked at
+	while(!is_empty_pid_queue(&done_jobs)){
+
+		int job_id = pop_front_pid_queue(&done_jobs);
+		job_struct* job = find_job(job_id);
+
+		// Print completion message
+		print_job_bg_complete(job_id, peek_back_pid_queue(&job->process_q),
+				      job->command);
+
+		if(show_usage){
+			putchar('\t');
+			print_job_usage(job);
+			putchar('\n');
+			fflush(stdout);
+		}
+
+		// Clean up the completed job
+		remove_job(job_id);
 	}
 }// end check_jobs_bg_status()
 
@@ -176,6 +567,13 @@ void print_job_bg_complete(int job_id, pid_t pid, const char* cmd) {
 }
 
 
+// Prints a message for a foreground job that was stopped
+void print_job_stopped(int job_id, pid_t pid, const char* cmd) {
+	printf("Stopped: \t");
+	print_job(job_id, pid, cmd);
+}
+
+
 /***************************************************************************
  * Functions to process commands
  ***************************************************************************/
@@ -191,26 +589,107 @@ void run_generic(GenericCommand cmd) {
 	char* exec = cmd.args[0];
 	char** args = cmd.args;
 
-	execvp(exec, args);
+	// Skip the $PATH walk when we already know where the program lives
+	const char* path = path_cache_lookup(exec);
+	if(NULL == path){
+		errno = ENOENT;
+		perror("ERROR: Failed to execute program");
+		return;
+	}
+
+	execv(path, args);
 
 	perror("ERROR: Failed to execute program");
 }
 
 
+// Write every byte described by iov, picking up after short writes
+static void writev_all(int fd, struct iovec* iov, int iovcnt) {
+
+	while(iovcnt > 0){
+		ssize_t n = writev(fd, iov, iovcnt);
+
+		if(n < 0){
+			if(EINTR == errno){
+				continue;
+			}
+			return;
+		}
+
+		// Skip the pieces that were written completely
+		while(iovcnt > 0 && (size_t) n >= iov->iov_len){
+			n -= iov->iov_len;
+			++iov;
+			--iovcnt;
+		}
+
+		if(iovcnt > 0){
+			iov->iov_base = (char*) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+}
+
+
 // Print strings
 void run_echo(EchoCommand cmd) {
-	// Print an array of strings. The args array is a NULL terminated (last
-	// string is always NULL) list of strings.
-	char** str = cmd.args;
-	while(NULL != *str){
-		printf("%s", *str);
-		str++;
+
+	// Anything already buffered has to come out first
+	fflush(stdout);
+
+	// The args array is a NULL terminated (last string is always NULL)
+	// list of strings.
+	size_t num_args = 0;
+	while(NULL != cmd.args[num_args]){
+		++num_args;
 	}
 
-	putchar('\n');
+	int fd = fileno(stdout);
 
-	// Flush the buffer before returning
-	fflush(stdout);
+	// Builtin pipeline stages point stdout at a memory stream
+	if(fd < 0){
+		for(size_t i = 0; i < num_args; ++i){
+			fputs(cmd.args[i], stdout);
+		}
+		putchar('\n');
+		fflush(stdout);
+		return;
+	}
+
+	// Gather the arguments and the newline so the line is written with one
+	// system call and reaches a pipe in one piece
+	if(num_args < IOV_MAX){
+		struct iovec iov[num_args + 1];
+
+		for(size_t i = 0; i < num_args; ++i){
+			iov[i].iov_base = cmd.args[i];
+			iov[i].iov_len = strlen(cmd.args[i]);
+		}
+		iov[num_args].iov_base = "\n";
+		iov[num_args].iov_len = 1;
+
+		writev_all(fd, iov, num_args + 1);
+		return;
+	}
+
+	// Too many pieces for writev(), so join them in one buffer
+	size_t len = 1;
+	for(size_t i = 0; i < num_args; ++i){
+		len += strlen(cmd.args[i]);
+	}
+
+	char* buf = malloc(len);
+	char* end = buf;
+
+	for(size_t i = 0; i < num_args; ++i){
+		end = stpcpy(end, cmd.args[i]);
+	}
+	*end = '\n';
+
+	struct iovec whole = { buf, len };
+	writev_all(fd, &whole, 1);
+
+	free(buf);
 }
 
 
@@ -219,8 +698,19 @@ void run_export(ExportCommand cmd) {
 
 	// Simply try to set the environment varible to the given value, no
 	// need to check that it is accurate
-	setenv(cmd.env_var, cmd.val, 1);
-	
+	write_env(cmd.env_var, cmd.val);
+
+	// Programs may live somewhere else now
+	if(0 == strcmp(cmd.env_var, "PATH")){
+		path_cache_reset();
+	}
+	else if(0 == strcmp(cmd.env_var, "PS1")){
+		set_prompt_format(cmd.val);
+	}
+	else if(0 == strcmp(cmd.env_var, "HOME")){
+		invalidate_prompt();
+	}
+
 }
 
 
@@ -236,7 +726,7 @@ void run_cd(CDCommand cmd) {
 		return;
 	}
 
-	const char *temp = getenv("PWD");
+	const char *temp = lookup_env("PWD");
 
 	// Actually change the working directory
 	if(0 != chdir(dir) ){
@@ -244,15 +734,15 @@ void run_cd(CDCommand cmd) {
 		return;
 	}
 
-	// Change environment variables
-	if( 0 != setenv("OLDPWD", temp, 1) ){
-		perror("ERROR: Failed to update OLDPWD");
-		return;
-	}
-	else if( 0 != setenv("PWD", dir, 1) ){
-		perror("ERROR: Failed to update PWD");
-		return;
+	// The prompt shows the working directory
+	invalidate_prompt();
+
+	// Change environment variables. OLDPWD is copied before PWD replaces the
+	// string temp points to.
+	if(NULL != temp){
+		write_env("OLDPWD", temp);
 	}
+	write_env("PWD", dir);
 }
 
 
@@ -262,29 +752,118 @@ void run_kill(KillCommand cmd) {
 	int signal = cmd.sig;
 	int job_id = cmd.job;
 
-	int num_jobs = length_job_queue(&bg_q);
-	for(int i = 0; i<num_jobs; i++){
-		// Grab the front
-		job_struct temp = pop_front_job_queue(&bg_q);
-		
-		if(job_id == temp.job_id){
-			size_t num_pids = length_pid_queue(&temp.process_q);
-			
-			for(int j = 0; j<num_pids; ++j){
-				// Grab pid and send signal
-				int pid = pop_front_pid_queue(&temp.process_q);
-				kill(pid, signal);
+	job_struct* job = find_job(job_id);
 
-				// Put it back in order
-				push_back_pid_queue(&temp.process_q, pid);
-			}
+	if(NULL == job){
+		return;
+	}
 
-		}
+	signal_job(job, job_id, signal);
+}
+
+
+// Finds the job named by the arguments of fg or bg, or the newest job
+static job_struct* find_job_arg(const char* name, char** args) {
+
+	int job_id = next_job_id() - 1;
+
+	if(NULL != args[0]){
+		// Both 2 and %2 name job 2
+		const char* id = ('%' == args[0][0]) ? args[0] + 1 : args[0];
+		char* end;
+		long n = strtol(id, &end, 10);
+
+		job_id = ('\0' == *id || '\0' != *end || n <= 0 || n > INT_MAX) ?
+			-1 : (int) n;
+	}
+
+	job_struct* job = find_job(job_id);
+
+	if(NULL == job){
+		fprintf(stderr, "%s: %s: no such job\n", name,
+			(NULL != args[0]) ? args[0] : "current");
+	}
+	else if(0 == job->num_running){
+		fprintf(stderr, "%s: job %d has terminated\n", name, job_id);
+		return NULL;
+	}
+
+	return job;
+}
+
+
+// Brings a job to the foreground, continuing it if it was stopped, and waits
+// for it
+void run_fg(FgCommand cmd) {
 
-		// Put job back in place
-		push_back_job_queue(&bg_q, temp);
+	job_struct* stored = find_job_arg("fg", cmd.args);
+
+	if(NULL == stored){
+		return;
+	}
+
+	int job_id = stored->job_id;
+	job_struct job = take_job(job_id);
+
+	reindex_job(&job, job_id, FOREGROUND_JOB_ID);
+
+	printf("%s\n", job.command);
+	fflush(stdout);
+
+	// run_script() blocks SIGCHLD while it starts the line, which is only
+	// this command
+	sigset_t mask;
+	pthread_sigmask(SIG_SETMASK, &child_sigmask, &mask);
+
+	give_terminal(job.pgid);
+	continue_job(&job, FOREGROUND_JOB_ID);
+	wait_for_fg_job(&job);
+
+	pthread_sigmask(SIG_SETMASK, &mask, NULL);
+
+	if(0 < job.num_running){
+		// Stopped again, it goes back under the same id
+		stop_fg_job(&job, job_id);
+	}
+	else{
+		free(job.command);
+		destroy_pid_queue(&job.process_q);
+	}
+}
+
+
+// Continues a stopped job in the background
+void run_bg(BgCommand cmd) {
+
+	job_struct* job = find_job_arg("bg", cmd.args);
+
+	if(NULL == job){
+		return;
 	}
 
+	if(0 == job->num_stopped){
+		fprintf(stderr, "bg: job %d is already running\n", job->job_id);
+		return;
+	}
+
+	continue_job(job, job->job_id);
+	print_job_bg_start(job->job_id, peek_front_pid_queue(&job->process_q),
+			   job->command);
+}
+
+
+// Updates the table of resolved program paths. Listing the table is done by
+// the child so that it can be piped and redirected.
+void run_hash(HashCommand cmd) {
+
+	for(char** arg = cmd.args; NULL != *arg; ++arg){
+		if(0 == strcmp(*arg, "-r")){
+			path_cache_reset();
+		}
+		else if(NULL == path_cache_refresh(*arg)){
+			fprintf(stderr, "hash: %s: not found\n", *arg);
+		}
+	}
 }
 
 
@@ -313,22 +892,39 @@ void run_pwd() {
 }
 
 
-// Prints all background jobs currently in the job list to stdout
-// USING THE FORMAT [job_id]<tab>#PID#<tab>commandstring
-void run_jobs() {
+// Prints one line of the jobs listing
+static void print_jobs_entry(job_struct* job) {
+	printf("[%d]\t#PID#\t%s\n", job->job_id, job->command);
+}
 
-	int num_jobs = length_job_queue(&bg_q);
-	
-	for(int i = 0; i<num_jobs; i++){
-		// Grab the front
-		job_struct temp = pop_front_job_queue(&bg_q);
 
-		printf("[%d]\t#PID#\t%s\n", temp.job_id, temp.command);
+// Prints one line of the long jobs listing, with the pid leading the job,
+// its state and the resources it has used
+static void print_jobs_long_entry(job_struct* job) {
 
-		// Put job back in place
-		push_back_job_queue(&bg_q, temp);
+	const char* state = "Running";
+
+	if(0 == job->num_running){
+		state = "Done";
+	}
+	else if(job->num_stopped == job->num_running){
+		state = "Stopped";
 	}
 
+	printf("[%d]\t%d\t%s\t", job->job_id,
+	       peek_front_pid_queue(&job->process_q), state);
+	print_job_usage(job);
+	printf("\t%s\n", job->command);
+}
+
+
+// Prints all background jobs currently in the job list to stdout
+// USING THE FORMAT [job_id]<tab>#PID#<tab>commandstring
+void run_jobs(JobsCommand cmd) {
+
+	apply_job_table(cmd.long_format ? print_jobs_long_entry :
+			print_jobs_entry);
+
 	fflush(stdout);
 
 // hidden in the bowels of the documentation, there is a helpful message
@@ -370,12 +966,31 @@ void child_run_command(Command cmd) {
 	  break;
 
 	case JOBS:
-	  run_jobs();
+	  run_jobs(cmd.jobs);
+	  break;
+
+	case HASH:
+	  if(NULL == cmd.hash.args[0]){
+		  print_path_cache();
+	  }
+	  break;
+
+	case PARALLEL:
+	  run_parallel(cmd.parallel);
+	  break;
+
+	// Only reached in a forked child, which copies like a stage would
+	case CAT:
+	case TEE:
+	  run_builtin_stage(cmd, -1, -1);
+	  finish_builtin_stages(true);
 	  break;
 
 	case EXPORT:
 	case CD:
 	case KILL:
+	case FG:
+	case BG:
 	case EXIT:
 	case EOC:
 	  break;
@@ -414,10 +1029,25 @@ void parent_run_command(Command cmd) {
 			run_kill(cmd.kill);
 			break;
 
+		case HASH:
+			run_hash(cmd.hash);
+			break;
+
+		case FG:
+			run_fg(cmd.fg);
+			break;
+
+		case BG:
+			run_bg(cmd.bg);
+			break;
+
 		case GENERIC:
 		case ECHO:
 		case PWD:
 		case JOBS:
+		case CAT:
+		case TEE:
+		case PARALLEL:
 		case EXIT:
 		case EOC:
 			break;
@@ -429,6 +1059,300 @@ void parent_run_command(Command cmd) {
 }
 
 
+/**
+ * @brief Opens the redirect target of a command in the quash process
+ *
+ * @param holder The CommandHolder holding the redirect file names
+ *
+ * @param fd Which redirect to open, STDIN_FILENO or STDOUT_FILENO
+ *
+ * @return An open close-on-exec file descriptor, or -1 on failure
+ */
+static int open_redirect(CommandHolder holder, int fd) {
+
+	int fp;
+
+	if(STDIN_FILENO == fd){
+		fp = open(holder.redirect_in, O_RDONLY | O_CLOEXEC);
+		if(fp < 0){
+			perror("Error: could not open file for input redirection");
+		}
+	}
+	else if(holder.flags & REDIRECT_APPEND){
+		fp = open(holder.redirect_out, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0777);
+		if(fp < 0){
+			perror("ERROR: could not open file for output redirection");
+		}
+	}
+	else{
+		fp = open(holder.redirect_out, O_WRONLY | O_TRUNC | O_CREAT | O_CLOEXEC, 0777);
+		if(fp < 0){
+			perror("Error: could not open file for output redirection");
+		}
+	}
+
+	return fp;
+}
+
+
+// posix_spawn() a program, running it with /bin/sh if the kernel does not
+// recognize it as an executable, like execvp() does for scripts without a
+// #! line
+static int spawn_program(pid_t* pid, const char* path,
+			 const posix_spawn_file_actions_t* actions,
+			 const posix_spawnattr_t* attr, char** args) {
+
+	int err = posix_spawn(pid, path, actions, attr, args, environ);
+
+	if(ENOEXEC != err){
+		return err;
+	}
+
+	size_t num_args = 0;
+	while(NULL != args[num_args]){
+		++num_args;
+	}
+
+	// /bin/sh path args[1] ... args[n - 1] NULL
+	char** sh_args = malloc((num_args + 2) * sizeof(char*));
+
+	if(NULL == sh_args){
+		return ENOMEM;
+	}
+
+	sh_args[0] = "/bin/sh";
+	sh_args[1] = (char*) path;
+	memcpy(sh_args + 2, args + 1, num_args * sizeof(char*));
+
+	err = posix_spawn(pid, "/bin/sh", actions, attr, sh_args, environ);
+	free(sh_args);
+
+	return err;
+}
+
+
+/**
+ * @brief Starts a @a GenericCommand without duplicating the quash address
+ * space
+ *
+ * posix_spawn() is built on clone(CLONE_VM | CLONE_VFORK) in glibc, so unlike
+ * fork() the cost of starting a program does not grow with the size of the
+ * quash heap. Pipe wiring and redirects are expressed as file actions applied
+ * in the same order the forked child applies them.
+ *
+ * @param holder The CommandHolder holding a GENERIC command
+ *
+ * @param in_fd Pipe end to connect to stdin, or -1 to leave stdin alone
+ *
+ * @param out_fd Pipe end to connect to stdout, or -1 to leave stdout alone
+ *
+ * @param[in,out] pgid Process group to join, or 0 to start a new one. Set to
+ * the group the process was placed in. NULL to stay in the process group of
+ * quash.
+ *
+ * @return The pid of the new process, or -1 if it could not be started
+ */
+static pid_t spawn_generic(CommandHolder holder, int in_fd, int out_fd,
+			   pid_t* pgid) {
+
+	pid_t pid = -1;
+	int r_in = -1, r_out = -1;
+
+	// Open redirects here so failures are reported just like before
+	if(holder.flags & REDIRECT_IN){
+		if((r_in = open_redirect(holder, STDIN_FILENO)) < 0){
+			return -1;
+		}
+	}
+	if(holder.flags & REDIRECT_OUT){
+		if((r_out = open_redirect(holder, STDOUT_FILENO)) < 0){
+			if(r_in >= 0){
+				close(r_in);
+			}
+			return -1;
+		}
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+
+	// Every pipe is close-on-exec, so only the ends being dup'd survive
+	if(in_fd >= 0){
+		posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+	}
+	if(out_fd >= 0){
+		posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+	}
+
+	// Redirects take precedence over pipes, as in the forked child
+	if(r_in >= 0){
+		posix_spawn_file_actions_adddup2(&actions, r_in, STDIN_FILENO);
+	}
+	if(r_out >= 0){
+		posix_spawn_file_actions_adddup2(&actions, r_out, STDOUT_FILENO);
+	}
+
+	// quash ignores SIGPIPE and the job control signals, which programs
+	// would otherwise inherit, and blocks SIGCHLD while starting them
+	posix_spawnattr_t attr;
+	sigset_t sigdef;
+	short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+
+	posix_spawnattr_init(&attr);
+	sigemptyset(&sigdef);
+	sigaddset(&sigdef, SIGPIPE);
+	sigaddset(&sigdef, SIGTSTP);
+	sigaddset(&sigdef, SIGTTIN);
+	sigaddset(&sigdef, SIGTTOU);
+	posix_spawnattr_setsigdefault(&attr, &sigdef);
+	posix_spawnattr_setsigmask(&attr, &child_sigmask);
+
+	if(NULL != pgid){
+		posix_spawnattr_setpgroup(&attr, *pgid);
+		flags |= POSIX_SPAWN_SETPGROUP;
+	}
+
+	posix_spawnattr_setflags(&attr, flags);
+
+	char** args = holder.cmd.generic.args;
+	const char* path = path_cache_lookup(args[0]);
+	int err = ENOENT;
+
+	if(NULL != path){
+		err = spawn_program(&pid, path, &actions, &attr, args);
+
+		// The program may have moved since we cached it
+		if(ENOENT == err && path != args[0] &&
+		   NULL != (path = path_cache_refresh(args[0]))){
+			err = spawn_program(&pid, path, &actions, &attr, args);
+		}
+
+		// Every process of the group may have been reaped since the
+		// last one joined it, in which case this one starts a new group
+		if(EPERM == err && NULL != pgid && 0 != *pgid){
+			*pgid = 0;
+			posix_spawnattr_setpgroup(&attr, 0);
+			err = spawn_program(&pid, path, &actions, &attr, args);
+		}
+	}
+
+	if(0 == err && NULL != pgid && 0 == *pgid){
+		*pgid = pid;
+	}
+
+	if(0 != err){
+		errno = err;
+		perror("ERROR: Failed to execute program");
+		pid = -1;
+	}
+
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+
+	if(r_in >= 0){
+		close(r_in);
+	}
+	if(r_out >= 0){
+		close(r_out);
+	}
+
+	return pid;
+}
+
+
+// Run a builtin stage in quash with its redirects applied
+static void start_builtin_stage(CommandHolder holder, int in_fd, int out_fd) {
+
+	if(holder.flags & REDIRECT_IN){
+		int fd = open_redirect(holder, STDIN_FILENO);
+
+		if(fd < 0){
+			if(out_fd >= 0){
+				close(out_fd);
+			}
+			return;
+		}
+		in_fd = fd;
+	}
+
+	if(holder.flags & REDIRECT_OUT){
+		int fd = open_redirect(holder, STDOUT_FILENO);
+
+		if(fd < 0){
+			if(in_fd >= 0){
+				close(in_fd);
+			}
+			return;
+		}
+		out_fd = fd;
+	}
+
+	run_builtin_stage(holder.cmd, in_fd, out_fd);
+}
+
+
+// Point fd at a redirect target, returning a copy of the old descriptor, -1
+// if fd was closed, or -2 if the redirect could not be opened
+static int push_redirect(CommandHolder holder, int fd) {
+
+	int target = open_redirect(holder, fd);
+
+	if(target < 0){
+		return -2;
+	}
+
+	int saved = fcntl(fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+
+	dup2(target, fd);
+	close(target);
+
+	return saved;
+}
+
+
+// Undo push_redirect()
+static void pop_redirect(int saved, int fd) {
+
+	if(saved >= 0){
+		dup2(saved, fd);
+		close(saved);
+	}
+	else if(-1 == saved){
+		close(fd);
+	}
+}
+
+
+// Run a builtin in the quash process with its redirects applied to our own
+// stdin and stdout for the duration of the command
+static void run_builtin_in_quash(CommandHolder holder) {
+
+	int saved_in = -2, saved_out = -2;
+
+	// Output still buffered belongs to the old stdout
+	fflush(stdout);
+
+	if(holder.flags & REDIRECT_IN){
+		if(-2 == (saved_in = push_redirect(holder, STDIN_FILENO))){
+			return;
+		}
+	}
+
+	if(holder.flags & REDIRECT_OUT){
+		if(-2 == (saved_out = push_redirect(holder, STDOUT_FILENO))){
+			pop_redirect(saved_in, STDIN_FILENO);
+			return;
+		}
+	}
+
+	child_run_command(holder.cmd);
+	fflush(stdout);
+
+	pop_redirect(saved_out, STDOUT_FILENO);
+	pop_redirect(saved_in, STDIN_FILENO);
+}
+
+
 /**
  * @brief Creates one new process centered around the @a Command in the @a
  * CommandHolder setting up redirects and pipes where needed
@@ -442,9 +1366,16 @@ void parent_run_command(Command cmd) {
  *
  * @param holder The CommandHolder to try to run
  *
+ * @param job The job the new process belongs to
+ *
+ * @param stage Position of the command in its pipeline
+ *
+ * @return The pid of the new process, or -1 if the command ran inside quash
+ * or could not be started
+ *
  * @sa Command CommandHolder
  */
-void create_process(CommandHolder holder, job_struct *job) {
+pid_t create_process(CommandHolder holder, job_struct *job, size_t stage) {
 
 	// Read the flags field from the parser
 	bool p_in  = holder.flags & PIPE_IN;
@@ -454,34 +1385,107 @@ void create_process(CommandHolder holder, job_struct *job) {
 	bool r_app = holder.flags & REDIRECT_APPEND;
 	// This can only be true if r_out is true
 
-	// Create only one pipe each time.  Start with the out pipe.  Since we
-	// can depend on the parser to never have p_out true on the final
-	// process in a pipe, we know we will always have exactly n-1 pipes
-	// for n processes.
-	if(p_out){
-		pipe(env_pipes[out_pipe]);	
-	}	
+	// All pipes were created by run_script(). Stage i reads from the pipe
+	// before it and writes to its own.
+	int in_fd = p_in ? pipes[stage - 1][0] : -1;
+	int out_fd = p_out ? pipes[stage][1] : -1;
+
+	CommandType type = get_command_holder_type(holder);
+
+	// Job control and parallel wait on jobs from quash itself, which a
+	// stage of a pipeline or a background command cannot do
+	if((FG == type || BG == type || PARALLEL == type) &&
+	   (p_in || p_out || (holder.flags & BACKGROUND))){
+		start_builtin_stage(holder, in_fd, out_fd);
+		fprintf(stderr, "%s: cannot run in pipelines or background "
+			"jobs\n", (FG == type) ? "fg" : (BG == type) ? "bg" :
+			"parallel");
+		return -1;
+	}
+
+	// Builtins only run inside quash as part of a foreground job. A
+	// background job needs processes to be tracked and signalled by. When
+	// interactive, cat and tee may read the terminal for as long as the
+	// user likes, so they need a process group to get the terminal and
+	// Ctrl-C or Ctrl-Z from it.
+	bool passthrough = is_passthrough_builtin(type);
+	bool in_quash = !(holder.flags & BACKGROUND) && !(passthrough && is_tty());
+
+	// Without job control a background job reads /dev/null rather than
+	// the input quash reads its script from, as POSIX sh does
+	if(!p_in && !r_in && (holder.flags & BACKGROUND) && !is_tty()){
+		in_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
+
+	// Builtin pipeline stages and the copying builtins run inside quash.
+	// The stage takes over the pipe ends.
+	if(GENERIC != type && in_quash && (p_in || p_out || passthrough)){
+		double start = trace_begin();
+		start_builtin_stage(holder, in_fd, out_fd);
+		parent_run_command(holder.cmd);
+		trace_end("builtin stage", start, 0, job->job_id);
+		return -1;
+	}
+
+	// Foreground builtins outside of a pipeline run right here
+	if(GENERIC != type && in_quash){
+		double start = trace_begin();
+		run_builtin_in_quash(holder);
+		parent_run_command(holder.cmd);
+		trace_end("builtin", start, 0, job->job_id);
+		return -1;
+	}
+
+	// Each job gets a process group of its own, led by its first process,
+	// so it can be signalled as a whole. The foreground jobs of a script
+	// stay in ours so signals from the terminal still reach them.
+	bool background = holder.flags & BACKGROUND;
+	bool own_group = background || is_tty();
+	pid_t pgid = job->pgid;
+
+	// Builtins still need a forked copy of quash to run in, but external
+	// programs can be started without copying our address space
+	double start = trace_begin();
+	pid_t pid;
+	if(GENERIC == type){
+		pid = spawn_generic(holder, in_fd, out_fd,
+				    own_group ? &pgid : NULL);
+	}
+	else{
+		pid = fork();
+	}
 
-	int pid = fork();
 	if(0 == pid){  // Child process
 
-		if(p_in || p_out){
+		if(own_group){
+			setpgid(0, pgid);
+		}
+
+		// quash ignores SIGPIPE for its own stages and the job control
+		// signals when interactive, its children must not
+		signal(SIGPIPE, SIG_DFL);
+		signal(SIGTSTP, SIG_DFL);
+		signal(SIGTTIN, SIG_DFL);
+		signal(SIGTTOU, SIG_DFL);
+		pthread_sigmask(SIG_SETMASK, &child_sigmask, NULL);
 
-			// If p_in, we need to connect the read end of the
-			// global input pipe.  The values of the indices are
-			// updated at the end of this function
-			if(p_in){
-				dup2(env_pipes[in_pipe][0], 0);
-				close(env_pipes[in_pipe][1]);
-			}
-	
-			// If p_out, we need to connect the write end of the
-			// global output pipe.  The values of the indices are
-			// updated at the end of this function
-			if(p_out){
-				dup2(env_pipes[out_pipe][1],1);
-				close(env_pipes[out_pipe][0]);
-			}
+		if(in_fd >= 0){
+			dup2(in_fd, 0);
+		}
+		if(p_out){
+			dup2(out_fd, 1);
+		}
+
+		// /dev/null is not one of the pipes closed below
+		if(!p_in && in_fd >= 0){
+			close(in_fd);
+		}
+
+		// Close every pipe end the parent has not closed yet so only
+		// stdin and stdout keep this stage's pipes open
+		for(size_t i = (stage > 0) ? stage - 1 : 0; i < num_pipes; ++i){
+			close(pipes[i][0]);
+			close(pipes[i][1]);
 		}
 
 
@@ -491,7 +1495,7 @@ void create_process(CommandHolder holder, job_struct *job) {
 			int fp = open(holder.redirect_in, O_RDONLY);
 			if (fp < 0){
 				perror("Error: could not open file for input redirection");
-				return;
+				exit(EXIT_FAILURE);
 			}
 
 			// Duplicate file descriptor to replace stdin
@@ -510,7 +1514,7 @@ void create_process(CommandHolder holder, job_struct *job) {
 
 				if(fp < 0){
 					perror("ERROR: could not open file for output redirection");
-					return;
+					exit(EXIT_FAILURE);
 				}
 
 				// duplicate the file descriptor to replace
@@ -540,7 +1544,7 @@ void create_process(CommandHolder holder, job_struct *job) {
 
 				if(fp < 0){
 					perror("Error: could not open file for output redirection");
-					return;	
+					exit(EXIT_FAILURE);
 				}
 
 				// duplicate the file descriptor to replace
@@ -552,52 +1556,56 @@ void create_process(CommandHolder holder, job_struct *job) {
 			}
 		} // end if(r_out)
 
+	start = trace_begin();
 	child_run_command(holder.cmd); // This should be done in the child branch of a fork
+	trace_end("builtin", start, 0, job->job_id);
 
 	exit(0);
 	
 	}// end if(0 == pid), child process block
 	else{
-		// Since we only create "out" pipes in parent, we need only
-		// close the out pipe write end
+		// posix_spawn() only returns once the program has been
+		// executed, so the span covers the exec as well
+		trace_end((GENERIC == type) ? "spawn" : "fork", start, pid,
+			  job->job_id);
+
+		// The child has its own copies now. Each pipe end is used by
+		// exactly one stage, so this is the only place it is closed.
+		if(in_fd >= 0){
+			close(in_fd);
+		}
 		if(p_out){
-			close(env_pipes[out_pipe][1]);	
-		}
-
-		// This is some hackery passed along by our TA.  It simply
-		// alternates them between 0 and 1 for use in the global pipe
-		// handles.  The assumption is that proc 1 will complete and
-		// be done with pipe 0 in time for proc 3 to use it, as
-		// enforced by the fact that each process will block until
-		// data arrives from the previous process.
-		//
-		// Here is a sweet picture in case you forget later
-		//
-		//
-		// Stage 1:
-		//		__________		__________
-		// proc 1	__pipe 0__	proc 2	__pipe 1__
-		//
-		// 
-		//
-		// Stage 2:
-		//		__________		__________
-		// proc 3 write	__pipe 0__	proc 2	__pipe 1__ proc 3 read
-		//
-		//
-		// and so on...
-		//
-		//
-		out_pipe = (out_pipe + 1) % 2;
-		in_pipe = (in_pipe + 1) % 2;
-		
+			close(out_fd);
+		}
+
 		// Add the child to the active foreground process queue
-		push_back_pid_queue(&(job->process_q), pid);
+		if(pid > 0){
+			push_back_pid_queue(&(job->process_q), pid);
+			index_pid(pid, job->job_id);
+			++job->num_running;
+
+			// The forked child joins its group too, so the group exists
+			// no matter which of the two runs first
+			if(GENERIC != type && own_group){
+				setpgid(pid, pgid);
+				pgid = (0 == pgid) ? pid : pgid;
+			}
+
+			// A process that had to start a group leads the job now
+			if(own_group && pgid != job->pgid){
+				job->pgid = pgid;
+
+				if(!background){
+					give_terminal(pgid);
+				}
+			}
+		}
 
 		// Guess what I do
 		parent_run_command(holder.cmd);
 	}
 
+	return pid;
 }
 
 
@@ -615,18 +1623,20 @@ void create_process(CommandHolder holder, job_struct *job) {
  */
 void run_script(CommandHolder* holders) {
 
-	// We only want to instantiate the bg_q once.  This is better encapsulated
-	// than the previous implementation with the globals in quash.c
+	// We only want to instantiate the done_jobs once.  This is better
+	// encapsulated than the previous implementation with the globals in
+	// quash.c
 	if (first_time == true) {
-		bg_q = new_destructable_job_queue (1, &destroy_struct);
+		done_jobs = new_pid_queue(1);
 		first_time = false;
 	}
 
 	if (holders == NULL)
 	  return;
 
-	// This enforces the order of operations.  Background jobs will only
-	// report completion when the next command is entered.
+	// This enforces the order of operations.  Background jobs are reaped
+	// as soon as they exit but only report completion when the next
+	// command is entered.
 	check_jobs_bg_status();
 
 	if (get_command_holder_type(holders[0]) == EXIT &&
@@ -639,47 +1649,142 @@ void run_script(CommandHolder* holders) {
 
 	// Global pid queue handle
 	the_job.process_q = new_pid_queue(1);
+	the_job.num_running = 0;
+	the_job.num_stopped = 0;
+	the_job.pgid = 0;
+	the_job.command = NULL;
+	the_job.utime = the_job.stime = (struct timeval) { 0, 0 };
+	the_job.maxrss = 0;
+	the_job.status = -1;
+	clock_gettime(CLOCK_MONOTONIC, &the_job.started);
+
+	// Background jobs get their id up front so their processes can be
+	// indexed as they are created
+	if (holders[0].flags & BACKGROUND) {
+		the_job.job_id = next_job_id();
+	}
+	else {
+		the_job.job_id = FOREGROUND_JOB_ID;
+	}
+
+	size_t num_stages = 0;
+
+	while (get_command_holder_type(holders[num_stages]) != EOC) {
+		++num_stages;
+	}
 
-	CommandType type;
+	// Create all n-1 pipes before starting any stage so no stage depends
+	// on another finishing first
+	num_pipes = num_stages - 1;
+
+	if (num_pipes > 0) {
+		double start = trace_begin();
+		pipes = malloc(num_pipes * sizeof(*pipes));
+
+		for (size_t i = 0; i < num_pipes; ++i) {
+			if (NULL == pipes || 0 != pipe2(pipes[i], O_CLOEXEC)) {
+				perror("ERROR: Failed to create pipe");
+
+				while (i-- > 0) {
+					close(pipes[i][0]);
+					close(pipes[i][1]);
+				}
+
+				free(pipes);
+				pipes = NULL;
+				num_pipes = 0;
+				destroy_pid_queue(&the_job.process_q);
+				return;
+			}
+		}
+
+		trace_end("pipe", start, 0, the_job.job_id);
+	}
+
+	// `time` only costs anything when it is used
+	bool timed = holders[0].flags & TIME_PIPELINE;
+	struct rusage self_before;
+
+	if (timed) {
+		getrusage(RUSAGE_SELF, &self_before);
+	}
+
+	if (holders[0].flags & TIME_STAGES) {
+		timed_stages = calloc(num_stages, sizeof(TimedStage));
+		num_timed_stages = (NULL != timed_stages) ? num_stages : 0;
+	}
+
+	// A process group disappears once its last process is reaped, so
+	// SIGCHLD waits until every stage has joined the group of the first.
+	// Helper threads started meanwhile keep it blocked for good.
+	sigset_t sigchld;
+	sigemptyset(&sigchld);
+	sigaddset(&sigchld, SIGCHLD);
+	pthread_sigmask(SIG_BLOCK, &sigchld, &child_sigmask);
 
 	// Run all commands in the `holder` array
-	for (int i = 0; (type = get_command_holder_type(holders[i])) != EOC; ++i){
-		create_process(holders[i], &the_job);
+	for (size_t i = 0; i < num_stages; ++i){
+		if (NULL == timed_stages) {
+			create_process(holders[i], &the_job, i);
+			continue;
+		}
+
+		// Nothing is reaped before the loop ends, so the pid is known
+		// by the time the stage's record is handled
+		clock_gettime(CLOCK_MONOTONIC, &timed_stages[i].started);
+		timed_stages[i].pid = create_process(holders[i], &the_job, i);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &child_sigmask, NULL);
+
+	free(pipes);
+	pipes = NULL;
+	num_pipes = 0;
+
+	// Background jobs are only tracked through their processes, so stages
+	// running inside quash are left to finish on their own
+	if (holders[0].flags & BACKGROUND) {
+		finish_builtin_stages(false);
 	}
 
 	// Foreground jobs should be completed immediately
 	if (!(holders[0].flags & BACKGROUND)) {
 		
-		// We need to wait for each to complete, then remove it from
-		// our queue of foreground processes
-		while(false == is_empty_pid_queue(&the_job.process_q)){
+		// We need to wait for each to complete or stop
+		wait_for_fg_job(&the_job);
 
-			int active, status;
-			// Grab the first item (presumably the oldest if we
-			// always add to the back)
-			active = pop_front_pid_queue(&the_job.process_q);
+		if (0 < the_job.num_running) {
+			// Stopped from the terminal, so it becomes a job and the
+			// stages run inside quash are left to finish on their own
+			finish_builtin_stages(false);
 
-			// Block until the associated process exits
-			waitpid(active, &status, 0);
+			the_job.command = get_command_string();
+			stop_fg_job(&the_job, next_job_id());
 		}
-		// Clean up process queue
-		destroy_pid_queue(&the_job.process_q);
-	}
-	else {
-	 	int jid, pid;
+		else {
+			// Stages run inside quash finish once their readers are
+			// gone
+			finish_builtin_stages(true);
+
+			// A pipeline stopped from the terminal is not timed
+			if (timed) {
+				report_time(holders, &the_job, &self_before);
+			}
 
-		// Make a struct to represent the job
-		// get the last pid
-		if(!is_empty_job_queue(&bg_q)){
-			// If there are jobs queued, the next job id is one
-			// more than that of the last job queued
-			jid = peek_back_job_queue(&bg_q).job_id + 1;
-		}
-		else{
-			jid = 1;	
+			// Clean up process queue
+			destroy_pid_queue(&the_job.process_q);
 		}
 
-		the_job.job_id = jid;
+		free(timed_stages);
+		timed_stages = NULL;
+		num_timed_stages = 0;
+	}
+	else if(is_empty_pid_queue(&the_job.process_q)){
+		// Nothing could be started, so there is no job to track
+		destroy_pid_queue(&the_job.process_q);
+	}
+	else {
+	 	int pid;
 
 		pid = peek_front_pid_queue(&the_job.process_q);
 
@@ -691,8 +1796,8 @@ void run_script(CommandHolder* holders) {
 		
 		// Load job into background queue, print feedback, return
 		// control to main block
-		push_back_job_queue(&bg_q, the_job);
-		print_job_bg_start(jid, pid, the_job.command);
+		add_job(the_job);
+		print_job_bg_start(the_job.job_id, pid, the_job.command);
 	}
 }// end run_script()
 
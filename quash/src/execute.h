@@ -11,6 +11,7 @@
 #include <unistd.h>
 
 #include "command.h"
+#include "job_struct.h"
 
 
 /**
@@ -18,7 +19,7 @@
  *
  * Within the execute.c file, there is no way to know if the parser has
  * decided to exit.  Thus the need for a simple function to signal that the
- * bg_q job_queue type be freed appropriately
+ * job table and the queue of finished jobs be freed appropriately
  *
  */
 void free_background_queue();
@@ -103,6 +104,26 @@ void print_job_bg_start(int job_id, pid_t pid, const char* cmd);
  */
 void print_job_bg_complete(int job_id, pid_t pid, const char* cmd);
 
+/**
+ * @brief Print that a foreground job was stopped to standard out
+ *
+ * @param job_id Job identifier number the job is now known by.
+ *
+ * @param pid Process id of a process belonging to this job.
+ *
+ * @param cmd String holding an aproximation of what the user typed in for the
+ * command.
+ */
+void print_job_stopped(int job_id, pid_t pid, const char* cmd);
+
+/**
+ * @brief Make quash the foreground process group of its terminal and ignore
+ * the signals that would stop it while it hands the terminal to jobs
+ *
+ * Only called when quash is interactive.
+ */
+void initialize_job_control();
+
 /**
  * @brief Run a generic (non-builtin) command
  *
@@ -148,6 +169,42 @@ void run_cd(CDCommand cmd);
  */
 void run_kill(KillCommand cmd);
 
+/**
+ * @brief Run the builtin hash command
+ *
+ * `hash -r` forgets every resolved program path and `hash name...` resolves
+ * each name again. Without arguments the table is printed instead, which is
+ * done in the child process.
+ *
+ * @param cmd A @a HashCommand
+ *
+ * @sa HashCommand, print_path_cache()
+ */
+void run_hash(HashCommand cmd);
+
+/**
+ * @brief Run the builtin fg command
+ *
+ * Hands the terminal to the job's process group, continues the job if it was
+ * stopped and waits for it like any other foreground job.
+ *
+ * @param cmd A @a FgCommand
+ *
+ * @sa FgCommand
+ */
+void run_fg(FgCommand cmd);
+
+/**
+ * @brief Run the builtin bg command
+ *
+ * Continues a stopped job without waiting for it.
+ *
+ * @param cmd A @a BgCommand
+ *
+ * @sa BgCommand
+ */
+void run_bg(BgCommand cmd);
+
 /**
  * @brief Run the builtin pwd (print working directory) command
  *
@@ -160,7 +217,69 @@ void run_pwd();
  *
  * @sa PWDCommand
  */
-void run_jobs();
+void run_jobs(JobsCommand cmd);
+
+/**
+ * @brief Run the part of a command that prints to stdout
+ *
+ * Called in a forked child, or inside quash with stdout pointed at a memory
+ * stream for builtin pipeline stages.
+ *
+ * @param cmd The Command to try to run
+ *
+ * @sa Command
+ */
+void child_run_command(Command cmd);
+
+/**
+ * @brief Start one command of a pipeline as a process of a job
+ *
+ * Pipes between the stages of a pipeline are set up by run_script(), so
+ * commands outside of it may only be started with a @a stage of 0 and without
+ * pipe flags.
+ *
+ * @param holder The CommandHolder to run
+ *
+ * @param job The job the new process belongs to. Its processes are placed in
+ * the process group @a job->pgid, which is set by the first of them.
+ *
+ * @param stage Position of the command in its pipeline
+ *
+ * @return The pid of the new process, or -1 if the command ran inside quash
+ * or could not be started
+ */
+pid_t create_process(CommandHolder holder, job_struct* job, size_t stage);
+
+/**
+ * @brief Wait for the next process of a foreground job to exit
+ *
+ * Records of background jobs that arrive in the meantime are accounted for
+ * as well. The terminal is taken back from the job once none of its
+ * processes are left running.
+ *
+ * @param job A job whose processes are indexed under FOREGROUND_JOB_ID
+ *
+ * @param[out] status Status of the exited process as reported by waitpid()
+ *
+ * @return The pid of the process that exited, or -1 if every remaining
+ * process of the job is stopped or none are left
+ */
+pid_t wait_for_job_exit(job_struct* job, int* status);
+
+/**
+ * @brief Send a signal to every process of a job
+ *
+ * The job's process group is signalled with a single call if it has one.
+ * Stopped processes are continued after SIGTERM, SIGHUP and SIGKILL so they
+ * act on the signal and no longer count as stopped.
+ *
+ * @param job The job to signal
+ *
+ * @param job_id Id the job's processes are indexed under
+ *
+ * @param sig Signal to send
+ */
+void signal_job(job_struct* job, int job_id, int sig);
 
 /**
  * @brief Common entry point for all commands
@@ -1,6 +1,10 @@
 #ifndef JOB_STRUCT
 #define JOB_STRUCT
 
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+
 #include "pid_queue.h"
 /*
  * @brief The job_struct type is used to manage batches of running processes
@@ -12,10 +16,38 @@ typedef struct{
 	/*  Stores the pids of the processes associated with this job, in
 	 *  order that they were created */
 	pid_queue process_q;
+
+	/* Number of processes in process_q that have not exited yet */
+	int num_running;
+
+	/* Number of running processes that are currently stopped */
+	int num_stopped;
+
+	/* Process group every process of the job is placed in, zero until
+	 * the first process has been created or if the job shares the
+	 * process group of quash */
+	pid_t pgid;
 	
 	/* Stores the current command buffer in a human-friendly format for
 	 * this job */
 	char* command;
+
+	/* CPU time spent in user and kernel mode by the processes of the
+	 * job that have exited */
+	struct timeval utime;
+	struct timeval stime;
+
+	/* Largest resident set size of any exited process in kilobytes */
+	long maxrss;
+
+	/* When the job was started and when its last process exited, on the
+	 * monotonic clock */
+	struct timespec started;
+	struct timespec finished;
+
+	/* Status of the last process of the pipeline as reported by
+	 * waitpid(), or -1 while it runs */
+	int status;
 } job_struct;
 
 #endif
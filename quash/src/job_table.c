@@ -0,0 +1,328 @@
+/**
+ * @file job_table.c
+ *
+ * @brief Implements the job id and pid indexed background job table
+ */
+
+#include "job_table.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+// Jobs indexed by job id. A slot is free when its job_id is zero, which is
+// never handed out to a background job.
+static job_struct* jobs = NULL;
+static size_t jobs_cap = 0;
+static size_t num_jobs = 0;
+static int max_job_id = 0;
+
+/*
+ * @brief One pid to job id mapping in the reverse index
+ */
+typedef struct PidEntry {
+	pid_t pid;	/* Process id, zero if the slot is free */
+	int job_id;	/* Job the process belongs to */
+	bool stopped;	/* Set while the process is stopped by a signal */
+} PidEntry;
+
+// Open addressing pid index, the capacity is always a power of two
+static PidEntry* pids = NULL;
+static size_t pids_cap = 0;
+static size_t num_pids = 0;
+
+// Initial number of slots in the pid index
+#define INITIAL_PIDS_CAP 64
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// Home slot of a pid in the index
+static size_t pid_slot(pid_t pid) {
+	// Multiplicative hashing spreads sequential pids across the table
+	return ((size_t) pid * 2654435761u) & (pids_cap - 1);
+}
+
+
+// Find the slot holding pid, or the free slot it belongs in
+static size_t find_pid_slot(pid_t pid) {
+
+	size_t i = pid_slot(pid);
+
+	while(0 != pids[i].pid && pid != pids[i].pid){
+		i = (i + 1) & (pids_cap - 1);
+	}
+
+	return i;
+}
+
+
+// Double the size of the pid index
+static void grow_pid_index() {
+
+	PidEntry* old = pids;
+	size_t old_cap = pids_cap;
+
+	pids_cap = (0 == old_cap) ? INITIAL_PIDS_CAP : 2 * old_cap;
+	pids = calloc(pids_cap, sizeof(PidEntry));
+
+	if(NULL == pids){
+		fprintf(stderr, "ERROR: Failed to allocate the pid index\n");
+		exit(-1);
+	}
+
+	for(size_t i = 0; i < old_cap; ++i){
+		if(0 != old[i].pid){
+			pids[find_pid_slot(old[i].pid)] = old[i];
+		}
+	}
+
+	free(old);
+}
+
+
+// Forget every process of a job
+static void unindex_job_pids(job_struct* job) {
+
+	pid_queue* q = &job->process_q;
+	size_t len = length_pid_queue(q);
+
+	for(size_t i = 0; i < len; ++i){
+		int pid = pop_front_pid_queue(q);
+		if(job->job_id == find_job_id_by_pid(pid)){
+			unindex_pid(pid);
+		}
+		push_back_pid_queue(q, pid);
+	}
+}
+
+
+// Mark a slot of the job table as free
+static void free_job_slot(job_struct* job) {
+
+	memset(job, 0, sizeof(job_struct));
+
+	--num_jobs;
+
+	// Find the newest remaining job so numbering continues from it
+	while(max_job_id > 0 && 0 == jobs[max_job_id].job_id){
+		--max_job_id;
+	}
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Same numbering as taking the id of the newest queued job plus one
+int next_job_id() {
+	return max_job_id + 1;
+}
+
+
+// Store a job in the slot matching its id
+void add_job(job_struct job) {
+
+	assert(job.job_id > 0);
+	assert(NULL == find_job(job.job_id));
+
+	if((size_t) job.job_id >= jobs_cap){
+		size_t old_cap = jobs_cap;
+
+		jobs_cap = (0 == jobs_cap) ? 16 : jobs_cap;
+		while((size_t) job.job_id >= jobs_cap){
+			jobs_cap *= 2;
+		}
+
+		jobs = realloc(jobs, jobs_cap * sizeof(job_struct));
+
+		if(NULL == jobs){
+			fprintf(stderr, "ERROR: Failed to allocate the job table\n");
+			exit(-1);
+		}
+
+		memset(jobs + old_cap, 0, (jobs_cap - old_cap) * sizeof(job_struct));
+	}
+
+	jobs[job.job_id] = job;
+	++num_jobs;
+
+	if(job.job_id > max_job_id){
+		max_job_id = job.job_id;
+	}
+}
+
+
+// Direct lookup by id
+job_struct* find_job(int job_id) {
+
+	if(job_id <= 0 || (size_t) job_id >= jobs_cap || 0 == jobs[job_id].job_id){
+		return NULL;
+	}
+
+	return &jobs[job_id];
+}
+
+
+// Reverse lookup through the pid index
+int find_job_id_by_pid(pid_t pid) {
+
+	if(0 == num_pids){
+		return -1;
+	}
+
+	size_t i = find_pid_slot(pid);
+
+	return (0 == pids[i].pid) ? -1 : pids[i].job_id;
+}
+
+
+// Add a pid to the index, keeping it at most half full
+void index_pid(pid_t pid, int job_id) {
+
+	if(2 * (num_pids + 1) > pids_cap){
+		grow_pid_index();
+	}
+
+	size_t i = find_pid_slot(pid);
+
+	if(0 == pids[i].pid){
+		pids[i] = (PidEntry) { pid, job_id, false };
+		++num_pids;
+	}
+	else{
+		pids[i].job_id = job_id;
+	}
+}
+
+
+// Flip the stopped flag of an indexed pid
+bool set_pid_stopped(pid_t pid, bool stopped) {
+
+	if(0 == num_pids){
+		return false;
+	}
+
+	size_t i = find_pid_slot(pid);
+
+	if(0 == pids[i].pid){
+		return false;
+	}
+
+	bool was_stopped = pids[i].stopped;
+	pids[i].stopped = stopped;
+
+	return was_stopped;
+}
+
+
+// Remove a pid from the index with backward shift deletion so no tombstones
+// are needed
+void unindex_pid(pid_t pid) {
+
+	if(0 == num_pids){
+		return;
+	}
+
+	size_t mask = pids_cap - 1;
+	size_t i = find_pid_slot(pid);
+
+	if(0 == pids[i].pid){
+		return;
+	}
+
+	size_t j = i;
+	while(true){
+		j = (j + 1) & mask;
+
+		if(0 == pids[j].pid){
+			break;
+		}
+
+		// Entries whose home slot lies cyclically in (i, j] stay put
+		size_t home = pid_slot(pids[j].pid);
+		if((i <= j) ? (i < home && home <= j) : (i < home || home <= j)){
+			continue;
+		}
+
+		pids[i] = pids[j];
+		i = j;
+	}
+
+	pids[i].pid = 0;
+	--num_pids;
+}
+
+
+// Remove and free a job
+void remove_job(int job_id) {
+
+	job_struct* job = find_job(job_id);
+
+	if(NULL == job){
+		return;
+	}
+
+	unindex_job_pids(job);
+
+	free(job->command);
+	destroy_pid_queue(&job->process_q);
+	free_job_slot(job);
+}
+
+
+// Remove a job but hand it back instead of freeing it
+job_struct take_job(int job_id) {
+
+	job_struct* slot = find_job(job_id);
+
+	assert(NULL != slot);
+
+	job_struct job = *slot;
+	free_job_slot(slot);
+
+	return job;
+}
+
+
+// Number of stored jobs
+size_t job_table_length() {
+	return num_jobs;
+}
+
+
+// Visit jobs in id order
+void apply_job_table(void (*func)(job_struct*)) {
+
+	for(int id = 1; id <= max_job_id; ++id){
+		if(0 != jobs[id].job_id){
+			func(&jobs[id]);
+		}
+	}
+}
+
+
+// Release everything
+void destroy_job_table() {
+
+	for(int id = 1; id <= max_job_id; ++id){
+		remove_job(id);
+	}
+
+	free(jobs);
+	free(pids);
+
+	jobs = NULL;
+	pids = NULL;
+	jobs_cap = pids_cap = 0;
+	num_pids = 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file job_table.h
+ *
+ * @brief Background job storage indexed by job id and by process id
+ *
+ * Jobs live in a table indexed directly by their job id, and every process
+ * that belongs to a job is recorded in a pid to job id index. Finding the job
+ * for a kill command or for an exited child is therefore a constant time
+ * lookup instead of a rotation through every queued job.
+ */
+
+#ifndef SRC_JOB_TABLE_H
+#define SRC_JOB_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "job_struct.h"
+
+/**
+ * @brief Job id under which the foreground job's processes are indexed
+ *
+ * The foreground job is owned by run_script() and is never stored in the
+ * table, but its processes can still be indexed so exited children are
+ * matched to it without a search.
+ */
+#define FOREGROUND_JOB_ID 0
+
+/**
+ * @brief Get the id the next background job should be given
+ *
+ * @return One more than the largest job id in the table, or 1 if the table is
+ * empty
+ */
+int next_job_id();
+
+/**
+ * @brief Store a background job
+ *
+ * @param job The job to store. The table takes ownership of its process queue
+ * and command string. The job_id field must already be set, and its processes
+ * should have been indexed with index_pid() as they were created.
+ */
+void add_job(job_struct job);
+
+/**
+ * @brief Look up a job by id
+ *
+ * @param job_id Id of the job
+ *
+ * @return A pointer to the stored job or NULL if there is no such job. The
+ * pointer is invalidated by the next call to add_job() or remove_job().
+ */
+job_struct* find_job(int job_id);
+
+/**
+ * @brief Look up the id of the job a process belongs to
+ *
+ * @param pid Process id to look up
+ *
+ * @return The id of the owning job, or -1 if the process is not indexed
+ */
+int find_job_id_by_pid(pid_t pid);
+
+/**
+ * @brief Record that a process belongs to a job
+ *
+ * A process that is already indexed is moved to the new job and keeps its
+ * stopped flag.
+ *
+ * @param pid Process id
+ *
+ * @param job_id Id of the job the process belongs to
+ */
+void index_pid(pid_t pid, int job_id);
+
+/**
+ * @brief Mark an indexed process as stopped or running
+ *
+ * @param pid Process id
+ *
+ * @param stopped True if the process has been stopped by a signal
+ *
+ * @return The previous value of the flag, false if the process is not indexed
+ */
+bool set_pid_stopped(pid_t pid, bool stopped);
+
+/**
+ * @brief Remove a process from the pid index
+ *
+ * @param pid Process id to forget
+ */
+void unindex_pid(pid_t pid);
+
+/**
+ * @brief Remove a job from the table and free it
+ *
+ * @param job_id Id of the job to remove
+ */
+void remove_job(int job_id);
+
+/**
+ * @brief Remove a job from the table without freeing it
+ *
+ * Used to bring a job to the foreground. Its processes stay indexed under
+ * the old job id until they are indexed again.
+ *
+ * @param job_id Id of a stored job
+ *
+ * @return The removed job. The caller takes ownership of its process queue
+ * and command string.
+ */
+job_struct take_job(int job_id);
+
+/**
+ * @brief Get the number of jobs in the table
+ *
+ * @return The number of stored jobs
+ */
+size_t job_table_length();
+
+/**
+ * @brief Call a function on every stored job in order of job id
+ *
+ * @param func Function to call. The job table must not be modified from it.
+ */
+void apply_job_table(void (*func)(job_struct*));
+
+/**
+ * @brief Free the job table along with every job left in it
+ */
+void destroy_job_table();
+
+#endif
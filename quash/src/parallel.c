@@ -0,0 +1,345 @@
+/**
+ * @file parallel.c
+ *
+ * @brief Implements the parallel builtin
+ */
+
+#define _GNU_SOURCE
+
+#include "parallel.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "execute.h"
+#include "job_table.h"
+#include "path_cache.h"
+#include "vector.h"
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+IMPLEMENT_VECTOR_STRUCT(Items, char*);
+IMPLEMENT_VECTOR(Items, char*);
+
+IMPLEMENT_VECTOR_STRUCT(Latencies, double);
+IMPLEMENT_VECTOR(Latencies, double);
+
+/*
+ * @brief An item that is currently running
+ */
+typedef struct Slot {
+	pid_t pid;		/* Process running the item */
+	struct timespec start;	/* When the process was started */
+} Slot;
+
+// Separates the command from the items on the command line
+#define ITEM_SEPARATOR ":::"
+
+// Smallest read() made from stdin
+#define READ_SIZE (1 << 16)
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// Seconds from one point in time to another
+static double elapsed(struct timespec from, struct timespec to) {
+	return (to.tv_sec - from.tv_sec) + (to.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+
+// Split all of stdin into lines, skipping empty ones. The lines point into
+// *buf, which the caller frees once the items have run.
+static Items read_stdin_items(char** buf) {
+
+	size_t cap = READ_SIZE, len = 0;
+	char* data = malloc(cap);
+
+	while(NULL != data){
+		// Always leave room for the NUL after the last line
+		if(len == cap){
+			char* grown = realloc(data, 2 * cap);
+
+			if(NULL == grown){
+				free(data);
+				data = NULL;
+				break;
+			}
+
+			data = grown;
+			cap *= 2;
+		}
+
+		ssize_t n = read(STDIN_FILENO, data + len, cap - len);
+
+		if(n < 0 && EINTR == errno){
+			continue;
+		}
+		if(n <= 0){
+			break;
+		}
+
+		len += n;
+	}
+
+	if(NULL == data){
+		fprintf(stderr, "ERROR: Failed to allocate the parallel items\n");
+		exit(-1);
+	}
+
+	Items items = new_Items(64);
+	char* line = data;
+	char* end = data + len;
+
+	while(line < end){
+		char* nl = memchr(line, '\n', end - line);
+
+		if(NULL == nl){
+			nl = end;
+		}
+
+		*nl = '\0';
+
+		if(nl > line){
+			push_back_Items(&items, line);
+		}
+
+		line = nl + 1;
+	}
+
+	*buf = data;
+	return items;
+}
+
+
+// Order latencies for qsort()
+static int compare_latencies(const void* a, const void* b) {
+
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+
+	return (x > y) - (x < y);
+}
+
+
+// Nearest rank percentile of sorted latencies
+static double percentile(Latencies* lat, size_t pct) {
+
+	size_t rank = (pct * lat->len + 99) / 100;
+
+	return lat->data[(rank > 0) ? rank - 1 : 0];
+}
+
+
+// Print throughput and the latency distribution of the items that ran
+static void report(Latencies* lat, size_t num_items, size_t num_failed,
+		   double total) {
+
+	fprintf(stderr, "parallel: %zu items in %.3f s, %.1f items/s, "
+		"%zu failed\n", num_items, total,
+		(total > 0) ? num_items / total : 0.0, num_failed);
+
+	if(is_empty_Latencies(lat)){
+		return;
+	}
+
+	qsort(lat->data, lat->len, sizeof(double), compare_latencies);
+
+	fprintf(stderr, "parallel: latency p50 %.3f ms, p90 %.3f ms, "
+		"p99 %.3f ms, max %.3f ms\n", percentile(lat, 50) * 1e3,
+		percentile(lat, 90) * 1e3, percentile(lat, 99) * 1e3,
+		peek_back_Latencies(lat) * 1e3);
+}
+
+
+// Print how parallel is used
+static void usage() {
+	fprintf(stderr, "usage: parallel [-j N] command [args...] "
+		"[::: item...]\n");
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Run a command once per item with a bounded number running at a time
+void run_parallel(ParallelCommand cmd) {
+
+	char** args = cmd.args;
+	long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(max_jobs < 1){
+		max_jobs = 1;
+	}
+
+	// Both -j N and -jN are accepted
+	if(NULL != args[0] && 0 == strncmp(args[0], "-j", 2)){
+		const char* num = ('\0' != args[0][2]) ? args[0] + 2 : args[1];
+		char* end;
+
+		if(NULL == num){
+			usage();
+			return;
+		}
+
+		max_jobs = strtol(num, &end, 10);
+
+		if('\0' == *num || '\0' != *end || max_jobs < 1){
+			usage();
+			return;
+		}
+
+		args += (num == args[1]) ? 2 : 1;
+	}
+
+	size_t num_words = 0;
+	while(NULL != args[num_words] &&
+	      0 != strcmp(args[num_words], ITEM_SEPARATOR)){
+		++num_words;
+	}
+
+	if(0 == num_words){
+		usage();
+		return;
+	}
+
+	// Checked once here rather than failing to start every item
+	if(NULL == path_cache_lookup(args[0])){
+		fprintf(stderr, "parallel: %s: command not found\n", args[0]);
+		return;
+	}
+
+	char* buf = NULL;
+	Items items;
+
+	if(NULL != args[num_words]){
+		items = new_Items(1);
+
+		for(char** item = args + num_words + 1; NULL != *item; ++item){
+			push_back_Items(&items, *item);
+		}
+	}
+	else{
+		items = read_stdin_items(&buf);
+	}
+
+	size_t num_items = length_Items(&items);
+
+	if((size_t) max_jobs > num_items){
+		max_jobs = (num_items > 0) ? num_items : 1;
+	}
+
+	// Every item runs the same argument vector with its own last argument.
+	// posix_spawn() copies it, so it is only built once.
+	char** argv = malloc((num_words + 2) * sizeof(char*));
+	Slot* slots = malloc(max_jobs * sizeof(Slot));
+
+	if(NULL == argv || NULL == slots){
+		fprintf(stderr, "ERROR: Failed to allocate the parallel slots\n");
+		exit(-1);
+	}
+
+	memcpy(argv, args, num_words * sizeof(char*));
+	argv[num_words + 1] = NULL;
+
+	CommandHolder holder = mk_command_holder(NULL, NULL, 0,
+						 mk_generic_command(argv));
+
+	// The items make up one foreground job, so the terminal and the
+	// accounting of exited children work just like for a pipeline
+	job_struct job = {
+		.job_id = FOREGROUND_JOB_ID,
+		.process_q = new_pid_queue(1),
+	};
+
+	Latencies latencies = new_Latencies(num_items);
+	size_t next = 0, num_running = 0, num_failed = 0;
+	struct timespec begin, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	while(next < num_items || num_running > 0){
+
+		// Refill every free slot
+		while(num_running < (size_t) max_jobs && next < num_items){
+			argv[num_words] = get_Items(&items, next++);
+
+			Slot* slot = &slots[num_running];
+
+			clock_gettime(CLOCK_MONOTONIC, &slot->start);
+			slot->pid = create_process(holder, &job, 0);
+
+			if(slot->pid < 0){
+				++num_failed;
+				continue;
+			}
+
+			++num_running;
+		}
+
+		if(0 == num_running){
+			break;
+		}
+
+		int status;
+		pid_t pid = wait_for_job_exit(&job, &status);
+
+		if(pid < 0){
+			// Every running item was stopped from the terminal. The
+			// rest are not started and the stopped ones are killed
+			// since there is no job left to continue them from.
+			fprintf(stderr, "parallel: stopped, %zu items not run\n",
+				num_items - next);
+
+			signal_job(&job, FOREGROUND_JOB_ID, SIGKILL);
+			num_items = next;
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		// At most N slots are in use, so a scan is all this needs
+		size_t i = 0;
+		while(slots[i].pid != pid){
+			++i;
+		}
+
+		push_back_Latencies(&latencies, elapsed(slots[i].start, now));
+		slots[i] = slots[--num_running];
+
+		if(!WIFEXITED(status) || 0 != WEXITSTATUS(status)){
+			++num_failed;
+		}
+
+		// Ctrl-C reaches the items rather than quash, and ends the run
+		// like it would end any other foreground job
+		if(WIFSIGNALED(status) && SIGINT == WTERMSIG(status) &&
+		   next < num_items){
+			fprintf(stderr, "parallel: interrupted, %zu items not run\n",
+				num_items - next);
+			num_items = next;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	report(&latencies, num_items, num_failed, elapsed(begin, now));
+
+	destroy_Latencies(&latencies);
+	destroy_pid_queue(&job.process_q);
+	destroy_Items(&items);
+	free(slots);
+	free(argv);
+	free(buf);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file parallel.h
+ *
+ * @brief The parallel builtin
+ *
+ * `parallel [-j N] command [args...] ::: item...` runs the command once for
+ * every item with the item appended to its arguments. Without `:::` the items
+ * are the lines of stdin. At most N items run at a time, the number of online
+ * processors by default, and a new item is started as soon as a running one
+ * exits. All of them belong to one foreground job, so they share a process
+ * group and the terminal like the stages of a pipeline.
+ *
+ * When every item has run, the number of items per second and the median,
+ * 90th and 99th percentile and maximum time an item took are printed to
+ * stderr.
+ */
+
+#ifndef SRC_PARALLEL_H
+#define SRC_PARALLEL_H
+
+#include "command.h"
+
+/**
+ * @brief Run the builtin parallel command
+ *
+ * Must be called from quash itself, not from a forked child, since it waits
+ * for the items through the reaper.
+ *
+ * @param cmd A @a ParallelCommand
+ *
+ * @sa ParallelCommand
+ */
+void run_parallel(ParallelCommand cmd);
+
+#endif
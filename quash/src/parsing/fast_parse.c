@@ -0,0 +1,267 @@
+#include "fast_parse.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "memory_pool.h"
+#include "parsing_interface.h"
+
+// Bytes that end a plain word: whitespace and the operators understood here
+static const bool __ends_word[256] = {
+  [' '] = true, ['\t'] = true, ['\r'] = true, ['\n'] = true,
+  ['|'] = true, ['&'] = true, ['<'] = true, ['>'] = true, ['#'] = true,
+};
+
+// Bytes that need the grammar. Control characters are included as well.
+static const bool __needs_grammar[256] = {
+  ['='] = true, ['\''] = true, ['\\'] = true, ['$'] = true,
+};
+
+// Find the first byte of [p, end) that ends a word or needs the grammar
+static inline char* __find_special(char* p, const char* end) {
+#ifdef __SSE2__
+  const __m128i space = _mm_set1_epi8(' ');
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) p);
+
+    // Everything up to and including the space character in one compare
+    __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(v, space), space);
+
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('|')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+
+    int bits = _mm_movemask_epi8(m);
+
+    if (bits != 0)
+      return p + __builtin_ctz(bits);
+
+    p += 16;
+  }
+#endif
+
+  while (p < end && !__ends_word[(unsigned char) *p] &&
+         !__needs_grammar[(unsigned char) *p] && (unsigned char) *p > ' ')
+    ++p;
+
+  return p;
+}
+
+// Find the end of the plain word at p, or NULL if it is empty or holds
+// anything the grammar has to handle
+static inline char* __scan_word(char* p, const char* end) {
+  char* word_end = __find_special(p, end);
+
+  if (word_end == p || (word_end < end && !__ends_word[(unsigned char) *word_end]))
+    return NULL;
+
+  return word_end;
+}
+
+// Check if a word is a keyword the lexer gives a token of its own. Words are
+// not terminated yet but always end in a byte that ends words.
+static inline bool __is_word(const char* word, const char* keyword) {
+  size_t len = strlen(keyword);
+
+  return strncmp(word, keyword, len) == 0 &&
+    __ends_word[(unsigned char) word[len]];
+}
+
+// Check if a stage starting with the given word must go through the grammar
+static bool __stage_needs_grammar(const char* first, size_t num_words) {
+  // Left to the grammar so their special handling lives in one place
+  if (__is_word(first, "cd") || __is_word(first, "export") ||
+      __is_word(first, "kill") || __is_word(first, "time"))
+    return true;
+
+  // These do not take arguments, which is a syntax error
+  if (__is_word(first, "pwd") || __is_word(first, "jobs") ||
+      __is_word(first, "exit") || __is_word(first, "quit"))
+    return num_words != 1;
+
+  return false;
+}
+
+// Build the command of one stage the way cmd_content does
+static Command __mk_stage_command(char** args) {
+  if (strcmp(args[0], "echo") == 0)
+    return mk_echo_command(args + 1);
+
+  if (strcmp(args[0], "pwd") == 0)
+    return mk_pwd_command();
+
+  if (strcmp(args[0], "jobs") == 0)
+    return mk_jobs_command(false);
+
+  if (strcmp(args[0], "exit") == 0 || strcmp(args[0], "quit") == 0)
+    return mk_exit_command();
+
+  return mk_word_command(args);
+}
+
+// Tokenize and build a line of simple commands
+bool fast_parse(char* line, size_t len, CommandHolder** holders) {
+  // A last line without a newline ends the input, which the grammar handles
+  if (len == 0 || line[len - 1] != '\n')
+    return false;
+
+  char* p = line;
+  const char* end = line + len - 1;
+
+  // The words of every stage go in one array with a NULL after each stage.
+  // Each stage's arguments are then a slice of that array.
+  Cmds cmds = new_Cmds(2);
+  CmdStrs words = new_CmdStrs(16);
+  CmdStrs word_ends = new_CmdStrs(16);
+  size_t stage_start = 0;
+  char* first = NULL;
+  char* redirect_in = NULL;
+  char* redirect_out = NULL;
+  bool append = false;
+  bool background = false;
+  bool redirected = false;
+
+  while (true) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+      ++p;
+
+    // A comment runs to the end of the line
+    char c = (p < end && *p != '#') ? *p : '\n';
+
+    if (c == '\n' || c == '|') {
+      size_t num_words = length_CmdStrs(&words) - stage_start;
+
+      if (num_words == 0) {
+        // Only an empty line is valid without a command
+        if (c == '\n' && is_empty_Cmds(&cmds) && !redirected) {
+          *holders = NULL;
+          return true;
+        }
+
+        return false;
+      }
+
+      // A background marker is only handled at the end of the line
+      if (background && c == '|')
+        return false;
+
+      if (__stage_needs_grammar(first, num_words))
+        return false;
+
+      char flags = (append ? REDIRECT_APPEND : 0) |
+        (redirect_out != NULL ? REDIRECT_OUT : 0) |
+        (redirect_in != NULL ? REDIRECT_IN : 0) |
+        (background ? BACKGROUND : 0);
+
+      // The command is built once the words are terminated
+      push_back_Cmds(&cmds, mk_command_holder(redirect_in, redirect_out,
+                                              flags, mk_eoc()));
+      push_back_CmdStrs(&words, NULL);
+
+      if (c == '\n')
+        break;
+
+      ++p;
+      stage_start = length_CmdStrs(&words);
+      redirect_in = redirect_out = NULL;
+      append = redirected = false;
+      continue;
+    }
+
+    if (c == '&') {
+      if (length_CmdStrs(&words) == stage_start || background)
+        return false;
+
+      background = true;
+      ++p;
+      continue;
+    }
+
+    // Nothing but the end of the line or a pipe may follow a &
+    if (background)
+      return false;
+
+    if (c == '<' || c == '>') {
+      bool is_append = c == '>' && p + 1 < end && p[1] == '>';
+
+      p += is_append ? 2 : 1;
+
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        ++p;
+
+      char* word_end = __scan_word(p, end);
+
+      if (word_end == NULL)
+        return false;
+
+      // The grammar keeps the first redirect of each direction
+      if (c == '<' && redirect_in == NULL) {
+        redirect_in = p;
+      }
+      else if (c == '>' && redirect_out == NULL) {
+        redirect_out = p;
+        append = is_append;
+      }
+
+      push_back_CmdStrs(&word_ends, word_end);
+      redirected = true;
+      p = word_end;
+      continue;
+    }
+
+    char* word_end = __scan_word(p, end);
+
+    // Words may not follow a redirect
+    if (word_end == NULL || redirected)
+      return false;
+
+    if (length_CmdStrs(&words) == stage_start)
+      first = p;
+
+    push_back_CmdStrs(&words, p);
+    push_back_CmdStrs(&word_ends, word_end);
+    p = word_end;
+  }
+
+  // Words are slices of the line. They are only terminated now that the line
+  // can no longer be handed to the lexer, which needs it unchanged.
+  for (size_t i = 0; i < word_ends.len; ++i)
+    *word_ends.data[i] = '\0';
+
+  char** args = as_array_CmdStrs(&words, NULL);
+  size_t num_cmds = length_Cmds(&cmds);
+
+  for (size_t i = 0; i < num_cmds; ++i) {
+    CommandHolder* holder = &cmds.data[i];
+
+    holder->cmd = __mk_stage_command(args);
+
+    while (*args++ != NULL)
+      ;
+
+    if (i + 1 < num_cmds)
+      holder->flags = (holder->flags & ~(REDIRECT_APPEND | REDIRECT_OUT)) | PIPE_OUT;
+
+    if (i > 0)
+      holder->flags = (holder->flags & ~REDIRECT_IN) | PIPE_IN;
+
+    // The background marker of the last stage applies to the whole pipeline
+    if (background)
+      holder->flags |= BACKGROUND;
+  }
+
+  push_back_Cmds(&cmds, mk_command_holder(NULL, NULL, 0, mk_eoc()));
+  *holders = as_array_Cmds(&cmds, NULL);
+
+  return true;
+}
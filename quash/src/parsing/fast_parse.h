@@ -0,0 +1,43 @@
+/**
+ * @file fast_parse.h
+ *
+ * @brief Hand written parser for simple command lines
+ *
+ * Most lines are plain words joined by pipes with a few redirects, such as
+ * `cmd arg arg | cmd > file &`. Lines like that are tokenized here without
+ * going through the flex scanner and the bison parser, scanning 16 bytes at a
+ * time with SSE2 when it is available. The resulting @a CommandHolder array is
+ * identical to the one the grammar builds. Anything else, including quotes,
+ * escapes, variables, assignments, cd, kill, time and syntax errors, is left to the
+ * grammar.
+ */
+
+#ifndef SRC_PARSING_FAST_PARSE_H
+#define SRC_PARSING_FAST_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "command.h"
+
+/**
+ * @brief Try to parse one line without the grammar
+ *
+ * @param line The line including its newline. The words of the line are
+ * terminated in place and used as the arguments of the commands, so the line
+ * must stay valid until the commands have run. It is only modified when true
+ * is returned.
+ *
+ * @param len Length of @a line
+ *
+ * @param[out] holders Set to the parsed command structure allocated on the @a
+ * MemoryPool, or NULL if the line holds no command
+ *
+ * @return True if the line was parsed and false if it must be given to the
+ * grammar instead
+ *
+ * @sa CommandHolder, MemoryPool
+ */
+bool fast_parse(char* line, size_t len, CommandHolder** holders);
+
+#endif
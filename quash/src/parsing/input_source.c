@@ -0,0 +1,150 @@
+#include "input_source.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Smallest read() made from stdin
+#define READ_SIZE (1 << 16)
+
+// Input that has been read but not handed out yet is [start, end) of buf
+static char* buf = NULL;
+static size_t cap = 0;
+static size_t start = 0;
+static size_t end = 0;
+static bool owns_buf = true;
+static bool at_eof = false;
+
+// Most recent line, and the part of it the lexer has not copied yet
+static char* line = NULL;
+static size_t line_len = 0;
+static char* pending = NULL;
+static size_t pending_len = 0;
+
+// Read more of stdin, making room at the end of the buffer first
+static bool __fill() {
+  if (at_eof)
+    return false;
+
+  // Lines handed out before this call are no longer needed
+  if (start > 0) {
+    memmove(buf, buf + start, end - start);
+    end -= start;
+    start = 0;
+  }
+
+  if (cap - end < READ_SIZE) {
+    char* grown = realloc(buf, cap + READ_SIZE);
+
+    if (grown == NULL) {
+      fprintf(stderr, "ERROR: Failed to allocate the input buffer\n");
+      exit(EXIT_FAILURE);
+    }
+
+    buf = grown;
+    cap += READ_SIZE;
+  }
+
+  ssize_t n;
+
+  do {
+    n = read(STDIN_FILENO, buf + end, cap - end);
+  } while (n < 0 && errno == EINTR);
+
+  if (n <= 0) {
+    at_eof = true;
+    return false;
+  }
+
+  end += n;
+  return true;
+}
+
+// Use a script in memory
+void set_input_buffer(char* script, size_t len) {
+  buf = script;
+  cap = len;
+  start = 0;
+  end = len;
+  owns_buf = false;
+  at_eof = true;
+}
+
+// Find the next newline, reading more input as needed
+char* next_input_line(size_t* len) {
+  char* nl;
+  size_t searched = start;
+
+  pending = NULL;
+  pending_len = 0;
+
+  while (true) {
+    nl = (searched < end) ? memchr(buf + searched, '\n', end - searched) : NULL;
+
+    if (nl != NULL)
+      break;
+
+    size_t offset = end - start;
+
+    if (!__fill())
+      break;
+
+    // The buffer may have moved, but the bytes searched so far do not need
+    // to be searched again
+    searched = start + offset;
+  }
+
+  if (nl == NULL) {
+    // The last line of the input does not need to end in a newline
+    if (start == end)
+      return line = NULL;
+
+    nl = buf + end - 1;
+  }
+
+  line = buf + start;
+  line_len = nl + 1 - line;
+  start += line_len;
+
+  *len = line_len;
+  return line;
+}
+
+// Let the lexer read the current line
+void unread_input_line() {
+  pending = line;
+  pending_len = line_len;
+}
+
+// YY_INPUT
+size_t read_input(char* dst, size_t max_size) {
+  if (pending_len == 0) {
+    size_t len;
+
+    if (next_input_line(&len) == NULL)
+      return 0;
+
+    unread_input_line();
+  }
+
+  size_t n = (pending_len < max_size) ? pending_len : max_size;
+
+  memcpy(dst, pending, n);
+  pending += n;
+  pending_len -= n;
+
+  return n;
+}
+
+// Release the buffer if it was allocated here
+void destroy_input_source() {
+  if (owns_buf)
+    free(buf);
+
+  buf = NULL;
+  line = pending = NULL;
+  cap = start = end = line_len = pending_len = 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file input_source.h
+ *
+ * @brief Line oriented access to the input of quash
+ *
+ * Input is read from stdin in large blocks, or taken from a script that is
+ * already in memory, and handed out one line at a time. The fast path of the
+ * parser looks at each line first. Lines it does not handle are given back
+ * and then read by the lexer through YY_INPUT, which never receives more than
+ * one line per call so the lexer never holds input past the line being
+ * parsed.
+ */
+
+#ifndef SRC_PARSING_INPUT_SOURCE_H
+#define SRC_PARSING_INPUT_SOURCE_H
+
+#include <stddef.h>
+
+/**
+ * @brief Read input from a buffer instead of stdin
+ *
+ * @param buf The whole script. It must stay valid and writable until
+ * destroy_input_source() is called. The caller keeps ownership.
+ *
+ * @param len Length of the script
+ */
+void set_input_buffer(char* buf, size_t len);
+
+/**
+ * @brief Get the next line of input
+ *
+ * @param[out] len Length of the line including its newline. Only the last
+ * line of the input can be missing the newline.
+ *
+ * @return A pointer to the line, or NULL at the end of the input. The line may
+ * be modified by the caller and stays valid until the next call.
+ */
+char* next_input_line(size_t* len);
+
+/**
+ * @brief Give the line returned by the last call to next_input_line() to the
+ * lexer
+ */
+void unread_input_line();
+
+/**
+ * @brief Copy input for the lexer
+ *
+ * Used as YY_INPUT. Serves the line given back with unread_input_line()
+ * first, then further lines one at a time.
+ *
+ * @param buf Buffer to fill
+ *
+ * @param max_size Size of @a buf
+ *
+ * @return The number of bytes copied, zero at the end of the input
+ */
+size_t read_input(char* buf, size_t max_size);
+
+/**
+ * @brief Free the stdin buffer
+ */
+void destroy_input_source();
+
+#endif
@@ -550,13 +550,17 @@ char *yytext;
 #include <stdlib.h>
 
 #include "deque.h"
+#include "input_source.h"
 #include "memory_pool.h"
 #include "parse.tab.h"
 #include "parsing_interface.h"
+
+// Read one line at a time from the input shared with the fast path
+#define YY_INPUT(buf, result, max_size) result = read_input(buf, max_size);
 #define YY_NO_INPUT 1
 /*string        ([a-zA-Z0-9\+\-\!@%\^\"\*.\{\}\[\]\(\)?\.,_~`/:;$]|\\(.|\n)|'(\\(.|\n)|[^\\'])*')+
 sim_str       [a-zA-Z0-9\+\-\!@%\^\"\*.\{\}\[\]\(\)?\.,_~`/:;]+*/
-#line 560 "src/parsing/lex.yy.c"
+#line 564 "src/parsing/lex.yy.c"
 
 #define INITIAL 0
 
@@ -772,10 +776,10 @@ YY_DECL
 		}
 
 	{
-#line 22 "src/parsing/parse.l"
+#line 26 "src/parsing/parse.l"
 
 
-#line 779 "src/parsing/lex.yy.c"
+#line 783 "src/parsing/lex.yy.c"
 
 	while ( /*CONSTCOND*/1 )		/* loops until end-of-file is reached */
 		{
@@ -844,121 +848,121 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 24 "src/parsing/parse.l"
+#line 28 "src/parsing/parse.l"
 { return PIPE;        }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 25 "src/parsing/parse.l"
+#line 29 "src/parsing/parse.l"
 { return BCKGRND;     }
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 26 "src/parsing/parse.l"
+#line 30 "src/parsing/parse.l"
 { return EQUALS;      }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 27 "src/parsing/parse.l"
+#line 31 "src/parsing/parse.l"
 { return REDIRIN;     }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 28 "src/parsing/parse.l"
+#line 32 "src/parsing/parse.l"
 { return REDIROUT;    }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 29 "src/parsing/parse.l"
+#line 33 "src/parsing/parse.l"
 { return REDIROUTAPP; }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 30 "src/parsing/parse.l"
+#line 34 "src/parsing/parse.l"
 { return ECHO_TOK;    }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 31 "src/parsing/parse.l"
+#line 35 "src/parsing/parse.l"
 { return EXPORT_TOK;  }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 32 "src/parsing/parse.l"
+#line 36 "src/parsing/parse.l"
 { return CD_TOK;      }
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 33 "src/parsing/parse.l"
+#line 37 "src/parsing/parse.l"
 { return PWD_TOK;     }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 34 "src/parsing/parse.l"
+#line 38 "src/parsing/parse.l"
 { return JOBS_TOK;    }
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
-#line 35 "src/parsing/parse.l"
+#line 39 "src/parsing/parse.l"
 { return KILL_TOK;    }
 	YY_BREAK
 case 13:
 /* rule 13 can match eol */
 YY_RULE_SETUP
-#line 36 "src/parsing/parse.l"
+#line 40 "src/parsing/parse.l"
 { return EOC_TOK;     }
 	YY_BREAK
 case YY_STATE_EOF(INITIAL):
-#line 37 "src/parsing/parse.l"
+#line 41 "src/parsing/parse.l"
 { return END;         }
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
-#line 38 "src/parsing/parse.l"
-{ yylval.str = memory_pool_strdup(yytext); return EXIT_TOK; }
+#line 42 "src/parsing/parse.l"
+{ yylval.str = memory_pool_strndup(yytext, yyleng); return EXIT_TOK; }
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 40 "src/parsing/parse.l"
-{ yylval.str = memory_pool_strdup(yytext); return NUM;     }
+#line 44 "src/parsing/parse.l"
+{ yylval.str = memory_pool_strndup(yytext, yyleng); return NUM;     }
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 41 "src/parsing/parse.l"
-{ yylval.str = memory_pool_strdup(yytext); return ID;      }
+#line 45 "src/parsing/parse.l"
+{ yylval.str = memory_pool_strndup(yytext, yyleng); return ID;      }
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
-#line 42 "src/parsing/parse.l"
-{ yylval.str = memory_pool_strdup(yytext); return SIM_STR; }
+#line 46 "src/parsing/parse.l"
+{ yylval.str = memory_pool_strndup(yytext, yyleng); return SIM_STR; }
 	YY_BREAK
 case 18:
 /* rule 18 can match eol */
 YY_RULE_SETUP
-#line 43 "src/parsing/parse.l"
-{ yylval.str = memory_pool_strdup(yytext); return STR;     }
+#line 47 "src/parsing/parse.l"
+{ yylval.str = interpret_complex_string_token(yytext, yyleng); return STR; }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 44 "src/parsing/parse.l"
+#line 48 "src/parsing/parse.l"
 { /* No action and no token */ }
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 45 "src/parsing/parse.l"
+#line 49 "src/parsing/parse.l"
 { /* No action and no token */ }
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 47 "src/parsing/parse.l"
+#line 51 "src/parsing/parse.l"
 { fprintf(stderr, "LEX: Unexpected symbol: %c (Line: %d)\n", *yytext, yylineno); }
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
-#line 49 "src/parsing/parse.l"
+#line 53 "src/parsing/parse.l"
 ECHO;
 	YY_BREAK
-#line 962 "src/parsing/lex.yy.c"
+#line 966 "src/parsing/lex.yy.c"
 
 	case YY_END_OF_BUFFER:
 		{
@@ -1928,7 +1932,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 49 "src/parsing/parse.l"
+#line 53 "src/parsing/parse.l"
 
 
 
@@ -1,6 +1,8 @@
 #include "memory_pool.h"
 
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,16 +23,50 @@
  * handle the allocation.
  */
 typedef struct MemoryPool {
-  void* pool;  /**< Pointer to the top of the memory pool */
-  size_t size; /**< Size of the memory pool in bytes */
-  void* next;  /**< The next pointer to be returned from an allocation */
+  void* pool;    /**< Pointer to the top of the memory pool */
+  size_t size;   /**< Size of the memory pool in bytes */
+  void* next;    /**< The next pointer to be returned from an allocation */
+  bool recycled; /**< True if the pool survived a reset_memory_pool() */
 } MemoryPool;
 
 IMPLEMENT_DEQUE_STRUCT(MemoryPoolDeque, MemoryPool);
 IMPLEMENT_DEQUE(MemoryPoolDeque, MemoryPool);
 
+// Pools holding the allocations made since the last reset. The back is the
+// pool allocations are currently made from.
 static MemoryPoolDeque pool_deq = { NULL, 0, 0, 0, NULL };
 
+// Rewound pools kept by reset_memory_pool() waiting to be used again
+static MemoryPoolDeque spare_deq = { NULL, 0, 0, 0, NULL };
+
+// Size requested by initialize_memory_pool()
+static size_t init_size = 0;
+
+// Bytes handed out since the last reset
+static size_t bytes_in_use = 0;
+
+// Decaying maximum of bytes_in_use across resets. Spare pools are trimmed
+// once the memory kept around is well beyond what recent lines needed.
+static size_t high_water = 0;
+
+static MemoryPoolStats stats = { 0, 0, 0, 0, 0, 0 };
+
+/**
+ * @brief A block given back with memory_pool_free()
+ *
+ * The link is stored in the block itself, so blocks smaller than this
+ * structure are not kept.
+ */
+typedef struct FreeBlock {
+  struct FreeBlock* next; /**< Next block in the same size class */
+} FreeBlock;
+
+// Size class i holds blocks of at least 2^i bytes
+#define MIN_SIZE_CLASS 3
+#define NUM_SIZE_CLASSES 24
+
+static FreeBlock* free_lists[NUM_SIZE_CLASSES];
+
 // Creates a single memory pool an returns a copy If the `size` parameter is
 // zero then this function will not allocate any space for later MemoryPool
 // allocations.
@@ -45,10 +81,14 @@ static MemoryPool __initialize_memory_pool(size_t size) {
       size = 0;
   }
 
+  if (mem != NULL)
+    ++stats.pools_allocated;
+
   return (MemoryPool) {
     mem,
     size,
-    mem
+    mem,
+    false
   };
 }
 
@@ -75,16 +115,37 @@ static MemoryPool __low_memory_initialize_memory_pool(size_t required_size,
 }
 
 static void __destroy_memory_pool(MemoryPool mp) {
-  if (mp.pool != NULL)
+  if (mp.pool != NULL) {
     free(mp.pool);
+    ++stats.pools_freed;
+  }
   mp.pool = NULL;
 }
 
+// Total capacity of a deque of pools
+static size_t __capacity_MemoryPoolDeque(MemoryPoolDeque* deq) {
+  size_t len = length_MemoryPoolDeque(deq);
+  size_t total = 0;
+
+  for (size_t i = 0; i < len; ++i) {
+    MemoryPool pool = pop_front_MemoryPoolDeque(deq);
+    total += pool.size;
+    push_back_MemoryPoolDeque(deq, pool);
+  }
+
+  return total;
+}
+
 void initialize_memory_pool(size_t size) {
   if (size == 0)
     size = 1;
 
+  init_size = size;
+  bytes_in_use = 0;
+  high_water = 0;
+
   pool_deq = new_destructable_MemoryPoolDeque(10, __destroy_memory_pool);
+  spare_deq = new_destructable_MemoryPoolDeque(10, __destroy_memory_pool);
 
   MemoryPool pool = __initialize_memory_pool(size);
 
@@ -95,19 +156,72 @@ void initialize_memory_pool(size_t size) {
   push_back_MemoryPoolDeque(&pool_deq, pool);
 }
 
-void* memory_pool_alloc(size_t size) {
+// Number of bytes needed to move ptr up to a multiple of align
+static inline size_t __padding(void* ptr, size_t align) {
+  return -(uintptr_t) ptr & (align - 1);
+}
+
+// Index of the smallest size class whose blocks can all hold size bytes
+static size_t __size_class(size_t size) {
+  size_t cls = MIN_SIZE_CLASS;
+
+  while (cls < NUM_SIZE_CLASSES && ((size_t) 1 << cls) < size)
+    ++cls;
+
+  return cls;
+}
+
+// Try to satisfy an allocation from the free lists
+static void* __free_list_alloc(size_t size, size_t align) {
+  size_t cls = __size_class(size);
+
+  // Only look a couple of classes up so small requests do not eat large
+  // blocks
+  for (size_t i = cls; i < NUM_SIZE_CLASSES && i <= cls + 2; ++i) {
+    FreeBlock* block = free_lists[i];
+
+    if (block != NULL && __padding(block, align) == 0) {
+      free_lists[i] = block->next;
+      stats.bytes_recycled += size;
+      return block;
+    }
+  }
+
+  return NULL;
+}
+
+void* memory_pool_alloc_aligned(size_t size, size_t align) {
   assert(!is_empty_MemoryPoolDeque(&pool_deq));
+  assert(align != 0 && (align & (align - 1)) == 0);
+  assert(align <= _Alignof(max_align_t));
+
+  void* ret = __free_list_alloc(size, align);
+
+  if (ret != NULL)
+    return ret;
 
   MemoryPool pool = peek_back_MemoryPoolDeque(&pool_deq);
-  size_t init_size = peek_front_MemoryPoolDeque(&pool_deq).size;
 
   assert(pool.pool != NULL);
   assert(pool.size != 0);
   assert(pool.next != NULL);
 
-  while (pool.next - pool.pool + size > pool.size) {
+  size_t pad = __padding(pool.next, align);
+
+  while (pool.next - pool.pool + pad + size > pool.size) {
     // There is not enough room in the current memory pool to fit the
-    // allocation. Create a new memory pool large enough to hold it. 
+    // allocation. Reuse a spare pool if the next one is large enough. The
+    // start of every pool is suitably aligned for any type.
+    pad = 0;
+
+    if (!is_empty_MemoryPoolDeque(&spare_deq) &&
+        peek_front_MemoryPoolDeque(&spare_deq).size >= size) {
+      pool = pop_front_MemoryPoolDeque(&spare_deq);
+      push_back_MemoryPoolDeque(&pool_deq, pool);
+      continue;
+    }
+
+    // Otherwise create a new memory pool large enough to hold it.
     size_t length_pool_deq = length_MemoryPoolDeque(&pool_deq);
     size_t new_pool_size = init_size * (2 << (length_pool_deq - 1));
 
@@ -130,8 +244,15 @@ void* memory_pool_alloc(size_t size) {
   }
 
   assert(pool.next == peek_back_MemoryPoolDeque(&pool_deq).next);
-  void* ret = pool.next;
-  pool.next += size;
+  ret = pool.next + pad;
+  pool.next += pad + size;
+
+  bytes_in_use += pad + size;
+
+  if (pool.recycled)
+    stats.bytes_reused += size;
+  else
+    stats.bytes_fresh += size;
 
   // Update record
   update_back_MemoryPoolDeque(&pool_deq, pool);
@@ -139,9 +260,119 @@ void* memory_pool_alloc(size_t size) {
   return ret;
 }
 
-// Free all memory contained in the MemoryPoolDeque
+// Align to the largest power of two dividing size. Every type's size is a
+// multiple of its alignment, so this is always enough for an array of any
+// type that takes up size bytes.
+void* memory_pool_alloc(size_t size) {
+  size_t align = size & -size;
+
+  if (align == 0 || align > _Alignof(max_align_t))
+    align = _Alignof(max_align_t);
+
+  return memory_pool_alloc_aligned(size, align);
+}
+
+// Grow the newest allocation of the current pool without moving it
+bool memory_pool_extend(void* ptr, size_t old_size, size_t new_size) {
+  assert(!is_empty_MemoryPoolDeque(&pool_deq));
+  assert(new_size >= old_size);
+
+  MemoryPool pool = peek_back_MemoryPoolDeque(&pool_deq);
+
+  if (ptr == NULL || ptr + old_size != pool.next ||
+      ptr - pool.pool + new_size > pool.size)
+    return false;
+
+  size_t grow = new_size - old_size;
+
+  pool.next += grow;
+  bytes_in_use += grow;
+
+  if (pool.recycled)
+    stats.bytes_reused += grow;
+  else
+    stats.bytes_fresh += grow;
+
+  ++stats.extensions;
+
+  update_back_MemoryPoolDeque(&pool_deq, pool);
+
+  return true;
+}
+
+// Keep a block for reuse by a later allocation of a similar size
+void memory_pool_free(void* ptr, size_t size) {
+  if (ptr == NULL || size < sizeof(FreeBlock) ||
+      __padding(ptr, _Alignof(FreeBlock)) != 0)
+    return;
+
+  // Find the largest class whose size the block can hold
+  size_t cls = __size_class(size);
+
+  if (cls >= NUM_SIZE_CLASSES)
+    cls = NUM_SIZE_CLASSES - 1;
+  else if (((size_t) 1 << cls) > size)
+    --cls;
+
+  FreeBlock* block = ptr;
+
+  block->next = free_lists[cls];
+  free_lists[cls] = block;
+}
+
+// Rewind every pool so the memory can be handed out again
+void reset_memory_pool() {
+  assert(!is_empty_MemoryPoolDeque(&pool_deq));
+
+  // Let the high water mark decay so one huge line does not pin its memory
+  // forever
+  high_water -= high_water / 16;
+
+  if (bytes_in_use > high_water)
+    high_water = bytes_in_use;
+
+  bytes_in_use = 0;
+
+  // Blocks on the free lists are about to be handed out again
+  memset(free_lists, 0, sizeof(free_lists));
+
+  // Pools in use go in front of the spares so they are reused in the same
+  // order they were first needed
+  while (!is_empty_MemoryPoolDeque(&pool_deq)) {
+    MemoryPool pool = pop_back_MemoryPoolDeque(&pool_deq);
+
+    if (pool.pool == NULL)
+      continue;
+
+    pool.next = pool.pool;
+    pool.recycled = true;
+    push_front_MemoryPoolDeque(&spare_deq, pool);
+  }
+
+  // Trim the largest spares while far more is kept than recent lines used
+  size_t kept = __capacity_MemoryPoolDeque(&spare_deq);
+  size_t limit = 2 * high_water + init_size;
+
+  while (kept > limit && length_MemoryPoolDeque(&spare_deq) > 1) {
+    MemoryPool pool = pop_back_MemoryPoolDeque(&spare_deq);
+
+    kept -= pool.size;
+    __destroy_memory_pool(pool);
+  }
+
+  push_back_MemoryPoolDeque(&pool_deq, pop_front_MemoryPoolDeque(&spare_deq));
+}
+
+// Get the allocation counters
+MemoryPoolStats get_memory_pool_stats() {
+  return stats;
+}
+
+// Free all memory contained in the MemoryPoolDeques
 void destroy_memory_pool() {
+  memset(free_lists, 0, sizeof(free_lists));
   destroy_MemoryPoolDeque(&pool_deq);
+  destroy_MemoryPoolDeque(&spare_deq);
 }
 
 // Simple replacement for strdup() that uses the memory pool rather than malloc
@@ -149,9 +380,21 @@ char* memory_pool_strdup(const char* str) {
   assert(str != NULL);
 
   size_t len = strlen(str) + 1;
-  char* ret = memory_pool_alloc(len);
+  char* ret = memory_pool_alloc_aligned(len, 1);
 
   strcpy(ret, str);
 
   return ret;
 }
+
+// Copy the first len bytes of str to the memory pool and terminate them
+char* memory_pool_strndup(const char* str, size_t len) {
+  assert(str != NULL);
+
+  char* ret = memory_pool_alloc_aligned(len + 1, 1);
+
+  memcpy(ret, str, len);
+  ret[len] = '\0';
+
+  return ret;
+}
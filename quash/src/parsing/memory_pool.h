@@ -20,9 +20,28 @@
 #ifndef SRC_PARSING_MEMORY_POOL_H
 #define SRC_PARSING_MEMORY_POOL_H
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "deque.h"
+#include "vector.h"
+
+/**
+ * @brief Counters describing how the memory pool has been used
+ *
+ * @sa get_memory_pool_stats()
+ */
+typedef struct MemoryPoolStats {
+  size_t bytes_reused;    /**< Bytes allocated from memory kept across a
+                           * reset_memory_pool() */
+  size_t bytes_fresh;     /**< Bytes allocated from newly malloc'd memory */
+  size_t bytes_recycled;  /**< Bytes allocated from blocks given back with
+                           * memory_pool_free() */
+  size_t extensions;      /**< Number of allocations grown in place by
+                           * memory_pool_extend() */
+  size_t pools_allocated; /**< Number of blocks requested from malloc() */
+  size_t pools_freed;     /**< Number of blocks returned with free() */
+} MemoryPoolStats;
 
 /**
  * @brief Allocate the memory pool
@@ -38,12 +57,81 @@ void initialize_memory_pool(size_t size);
  * malloc() without the requirement of calling free() directly on the returned
  * pointer.
  *
+ * The address is aligned to the largest power of two that divides @a size (up
+ * to the alignment of max_align_t), which is enough for an array of any type
+ * occupying @a size bytes.
+ *
  * @param size Size in bytes of the requested reserved space
  *
  * @return A pointer to a unique array of size bytes
+ *
+ * @sa memory_pool_alloc_aligned()
  */
 void* memory_pool_alloc(size_t size);
 
+/**
+ * @brief Like memory_pool_alloc() but with an explicit alignment
+ *
+ * @param size Size in bytes of the requested reserved space
+ *
+ * @param align Required alignment of the returned address. Must be a power of
+ * two no larger than the alignment of max_align_t.
+ *
+ * @return A pointer to a unique array of size bytes aligned to @a align
+ */
+void* memory_pool_alloc_aligned(size_t size, size_t align);
+
+/**
+ * @brief Try to grow an allocation without moving it
+ *
+ * This only succeeds for the most recent allocation from the current block of
+ * the pool when the block has room left for the extra bytes.
+ *
+ * @param ptr A block returned by one of the memory pool allocation functions
+ *
+ * @param old_size The size the block was allocated with
+ *
+ * @param new_size The size the block should have. Must not be smaller than @a
+ * old_size.
+ *
+ * @return True if the block now holds @a new_size bytes, false if it was left
+ * untouched and the caller must allocate a new block instead
+ */
+bool memory_pool_extend(void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Hand a block back to the memory pool before the next reset
+ *
+ * The block is kept on a free list for its size class and handed out again by
+ * a later allocation of a similar size. Calling this is optional, since every
+ * allocation is reclaimed by reset_memory_pool() or destroy_memory_pool()
+ * anyway. Blocks too small or too poorly aligned to hold a free list link are
+ * ignored.
+ *
+ * @param ptr A block returned by one of the memory pool allocation functions
+ *
+ * @param size The size the block was allocated with
+ */
+void memory_pool_free(void* ptr, size_t size);
+
+/**
+ * @brief Invalidate every allocation in the memory pool while keeping the
+ * memory for later allocations
+ *
+ * This is cheaper than pairing destroy_memory_pool() with
+ * initialize_memory_pool() since the blocks grown for earlier allocations are
+ * reused rather than free'd and malloc'd again. Blocks are only free'd when the
+ * pool holds far more than recent use has needed.
+ */
+void reset_memory_pool();
+
+/**
+ * @brief Get counters describing the use of the memory pool so far
+ *
+ * @return A copy of the counters
+ */
+MemoryPoolStats get_memory_pool_stats();
+
 /**
  * @brief Free all memory allocated in the memory pool
  */
@@ -59,6 +147,21 @@ void destroy_memory_pool();
  */
 char* memory_pool_strdup(const char* str);
 
+/**
+ * @brief A version of strndup() that allocates the duplicate to the memory pool
+ *
+ * Unlike strndup() the length is not searched for a NUL byte, so @a str only
+ * needs @a len readable bytes.
+ *
+ * @param str Pointer to the characters to duplicate
+ *
+ * @param len Number of characters to copy
+ *
+ * @return A NUL terminated copy of the first @a len bytes of str allocated in
+ * the memory pool
+ */
+char* memory_pool_strndup(const char* str, size_t len);
+
 /**
  * @brief Generates a @a memory_pool_alloc() based set of functions for use with
  * a structure generated by @a IMPLEMENT_DEQUE_STRUCT
@@ -79,11 +182,12 @@ char* memory_pool_strdup(const char* str);
     struct_name ret;                                                    \
                                                                         \
     if (init_cap > 0)                                                   \
-      ret.cap = init_cap;                                               \
+      ret.cap = __deque_capacity(init_cap);                             \
     else                                                                \
       ret.cap = 1;                                                      \
                                                                         \
-    ret.data = (type*) memory_pool_alloc(ret.cap * sizeof(type));       \
+    ret.data = (type*) memory_pool_alloc_aligned(                       \
+      ret.cap * sizeof(type), _Alignof(type));                          \
                                                                         \
     if (ret.data == NULL) {                                             \
       fprintf(stderr, "ERROR: Failed to reallocate struct_name"         \
@@ -137,7 +241,7 @@ char* memory_pool_strdup(const char* str);
   size_t length_##struct_name(struct_name* deq) {                       \
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
-    return (deq->back - deq->front + deq->cap) % deq->cap;              \
+    return (deq->back - deq->front) & (deq->cap - 1);                   \
   }                                                                     \
                                                                         \
   static void __reallign_##struct_name(struct_name* deq) {              \
@@ -148,7 +252,8 @@ char* memory_pool_strdup(const char* str);
       type* old_data = deq->data;                                       \
       size_t len = length_##struct_name(deq);                           \
                                                                         \
-      deq->data = (type*) memory_pool_alloc(deq->cap * sizeof(type));   \
+      deq->data = (type*) memory_pool_alloc_aligned(                    \
+        deq->cap * sizeof(type), _Alignof(type));                       \
                                                                         \
       if (deq->data == NULL) {                                          \
         fprintf(stderr, "ERROR: Failed to reallocate struct_name"       \
@@ -156,13 +261,13 @@ char* memory_pool_strdup(const char* str);
         abort();                                                        \
       }                                                                 \
                                                                         \
-      size_t i;                                                         \
+      __deque_unwrap(deq->data, old_data, deq->front, len, deq->cap,    \
+                     sizeof(type));                                     \
                                                                         \
-      for (i = 0; i < len; ++i)                                         \
-        deq->data[i] = old_data[(deq->front + i) % deq->cap];           \
+      memory_pool_free(old_data, deq->cap * sizeof(type));              \
                                                                         \
       deq->front = 0;                                                   \
-      deq->back = i;                                                    \
+      deq->back = len;                                                  \
     }                                                                   \
   }                                                                     \
                                                                         \
@@ -190,17 +295,33 @@ char* memory_pool_strdup(const char* str);
     size_t len = length_##struct_name(deq);                             \
                                                                         \
     for (size_t i = 0; i < len; ++i) {                                  \
-      func(deq->data[(deq->front + i) % deq->cap]);                     \
+      func(deq->data[(deq->front + i) & (deq->cap - 1)]);               \
     }                                                                   \
   }                                                                     \
                                                                         \
   static void __on_push_##struct_name(struct_name* deq) {               \
-    if (deq->front == (deq->back + 1) % deq->cap) {                     \
+    if (deq->front == ((deq->back + 1) & (deq->cap - 1))) {             \
       type* old_data = deq->data;                                       \
       size_t old_cap = deq->cap;                                        \
                                                                         \
       deq->cap = 2 * deq->cap;                                          \
-      deq->data = (type*) memory_pool_alloc(deq->cap * sizeof(type));   \
+                                                                        \
+      /* Growing in place only requires unwrapping the elements that */ \
+      /* sit before front, which never happens for append only use */   \
+      if (memory_pool_extend(old_data, old_cap * sizeof(type),          \
+                             deq->cap * sizeof(type))) {                \
+        if (deq->front != 0) {                                          \
+          memcpy(deq->data + old_cap, deq->data,                        \
+                 deq->back * sizeof(type));                             \
+                                                                        \
+          deq->back += old_cap;                                         \
+        }                                                               \
+                                                                        \
+        return;                                                         \
+      }                                                                 \
+                                                                        \
+      deq->data = (type*) memory_pool_alloc_aligned(                    \
+        deq->cap * sizeof(type), _Alignof(type));                       \
                                                                         \
       if (deq->data == NULL) {                                          \
         fprintf(stderr, "ERROR: Failed to reallocate struct_name"       \
@@ -208,13 +329,14 @@ char* memory_pool_strdup(const char* str);
         abort();                                                        \
       }                                                                 \
                                                                         \
-      size_t i;                                                         \
+      __deque_unwrap(deq->data, old_data, deq->front, old_cap - 1,      \
+                     old_cap, sizeof(type));                            \
                                                                         \
-      for (i = 0; i < old_cap - 1; ++i)                                 \
-        deq->data[i] = old_data[(deq->front + i) % old_cap];            \
+      /* Let a later allocation reuse the abandoned array */            \
+      memory_pool_free(old_data, old_cap * sizeof(type));               \
                                                                         \
       deq->front = 0;                                                   \
-      deq->back = i;                                                    \
+      deq->back = old_cap - 1;                                          \
     }                                                                   \
   }                                                                     \
                                                                         \
@@ -230,7 +352,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_push_##struct_name(deq);                                       \
-    deq->front = (deq->front + deq->cap - 1) % deq->cap;                \
+    deq->front = (deq->front - 1) & (deq->cap - 1);                     \
     deq->data[deq->front] = element;                                    \
   }                                                                     \
                                                                         \
@@ -239,7 +361,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_push_##struct_name(deq);                                       \
     deq->data[deq->back] = element;                                     \
-    deq->back = (deq->back + 1) % deq->cap;                             \
+    deq->back = (deq->back + 1) & (deq->cap - 1);                       \
   }                                                                     \
                                                                         \
   type pop_front_##struct_name(struct_name* deq) {                      \
@@ -247,7 +369,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_pop_##struct_name(deq);                                        \
     size_t old_front = deq->front;                                      \
-    deq->front = (deq->front + 1) % deq->cap;                           \
+    deq->front = (deq->front + 1) & (deq->cap - 1);                     \
     return deq->data[old_front];                                        \
   }                                                                     \
                                                                         \
@@ -255,7 +377,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     __on_pop_##struct_name(deq);                                        \
-    deq->back = (deq->back + deq->cap - 1) % deq->cap;                  \
+    deq->back = (deq->back - 1) & (deq->cap - 1);                       \
     return deq->data[deq->back];                                        \
   }                                                                     \
                                                                         \
@@ -270,7 +392,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     assert(!is_empty_##struct_name(deq));                               \
-    return deq->data[(deq->back + deq->cap - 1) % deq->cap];            \
+    return deq->data[(deq->back - 1) & (deq->cap - 1)];                 \
   }                                                                     \
                                                                         \
   void update_front_##struct_name(struct_name* deq, type element) {     \
@@ -284,7 +406,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq != NULL);                                                \
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     assert(!is_empty_##struct_name(deq));                               \
-    deq->data[(deq->back + deq->cap - 1) % deq->cap] = element;         \
+    deq->data[(deq->back - 1) & (deq->cap - 1)] = element;              \
   }                                                                     \
                                                                         \
   void update_and_destroy_front_##struct_name(struct_name* deq,         \
@@ -307,7 +429,7 @@ char* memory_pool_strdup(const char* str);
     assert(deq->data != NULL); /* Make sure the structure is valid */   \
     assert(!is_empty_##struct_name(deq));                               \
                                                                         \
-    size_t idx = (deq->back + deq->cap - 1) % deq->cap;                 \
+    size_t idx = (deq->back - 1) & (deq->cap - 1);                      \
                                                                         \
     if (deq->destructor != NULL)                                        \
       deq->destructor(deq->data[idx]);                                  \
@@ -315,4 +437,87 @@ char* memory_pool_strdup(const char* str);
     deq->data[idx] = element;                                           \
   }
 
+/**
+ * @brief Generates a @a memory_pool_alloc() based set of functions for use with
+ * a structure generated by @a IMPLEMENT_VECTOR_STRUCT
+ *
+ * A vector that is the most recent allocation on the pool grows in place.
+ *
+ * @param struct_name The name of the structure
+ *
+ * @param type The name of the type of elements stored in the @a struct_name
+ * structure
+ *
+ * @sa IMPLEMENT_VECTOR_STRUCT, PROTOTYPE_VECTOR, IMPLEMENT_VECTOR,
+ * memory_pool_alloc()
+ */
+#define IMPLEMENT_VECTOR_MEMORY_POOL(struct_name, type)                 \
+                                                                        \
+  void apply_##struct_name(struct_name*, void (*)(type));               \
+                                                                        \
+  struct_name new_##struct_name(size_t init_cap) {                      \
+    struct_name ret;                                                    \
+                                                                        \
+    if (init_cap > 0)                                                   \
+      ret.cap = init_cap;                                               \
+    else                                                                \
+      ret.cap = 1;                                                      \
+                                                                        \
+    ret.data = (type*) memory_pool_alloc_aligned(                       \
+      ret.cap * sizeof(type), _Alignof(type));                          \
+                                                                        \
+    if (ret.data == NULL) {                                             \
+      fprintf(stderr, "ERROR: Failed to allocate struct_name"           \
+              " contents");                                             \
+      abort();                                                          \
+    }                                                                   \
+                                                                        \
+    ret.len = 0;                                                        \
+    ret.destructor = NULL;                                              \
+                                                                        \
+    return ret;                                                         \
+  }                                                                     \
+                                                                        \
+  void destroy_##struct_name(struct_name* vec) {                        \
+    assert(vec != NULL);                                                \
+                                                                        \
+    if (vec->data == NULL)                                              \
+      return;                                                           \
+                                                                        \
+    if (vec->destructor != NULL)                                        \
+      apply_##struct_name(vec, vec->destructor);                        \
+                                                                        \
+    vec->data = NULL;                                                   \
+    vec->cap = vec->len = 0;                                            \
+  }                                                                     \
+                                                                        \
+  static void __grow_##struct_name(struct_name* vec, size_t min_cap) {  \
+    size_t cap = 2 * vec->cap;                                          \
+                                                                        \
+    if (cap < min_cap)                                                  \
+      cap = min_cap;                                                    \
+                                                                        \
+    if (!memory_pool_extend(vec->data, vec->cap * sizeof(type),         \
+                            cap * sizeof(type))) {                      \
+      type* data = (type*) memory_pool_alloc_aligned(                   \
+        cap * sizeof(type), _Alignof(type));                            \
+                                                                        \
+      if (data == NULL) {                                               \
+        fprintf(stderr, "ERROR: Failed to reallocate struct_name"       \
+                " contents\n");                                         \
+        abort();                                                        \
+      }                                                                 \
+                                                                        \
+      memcpy(data, vec->data, vec->len * sizeof(type));                 \
+                                                                        \
+      /* Let a later allocation reuse the abandoned array */            \
+      memory_pool_free(vec->data, vec->cap * sizeof(type));             \
+      vec->data = data;                                                 \
+    }                                                                   \
+                                                                        \
+    vec->cap = cap;                                                     \
+  }                                                                     \
+                                                                        \
+  __IMPLEMENT_VECTOR_COMMON(struct_name, type)
+
 #endif
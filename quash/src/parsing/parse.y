@@ -12,6 +12,11 @@ extern int yylineno;
 extern char* yytext;
 extern FILE* yyin;
 
+static void __propagate_background(Cmds* cmds);
+static char* __apply_time(CommandHolder* holder);
+static Command __mk_cd_command(char* dir);
+static void __command_error(char* str);
+
 extern void yyerror(CommandHolder**, char*);
 extern int yyparse(CommandHolder**);
 extern int yylex();
@@ -66,7 +71,15 @@ top:    EOC_TOK {
 
   YYACCEPT;
 }
+|       END {
+  *__ret_cmds = NULL;
+
+  end_main_loop(EXIT_SUCCESS);
+
+  YYACCEPT;
+}
 |       cmds EOC_TOK {
+  __propagate_background(&$1);
   push_back_Cmds(&$1, mk_command_holder(NULL, NULL, 0, mk_eoc()));
 
   *__ret_cmds = as_array_Cmds(&$1, NULL);
@@ -74,6 +87,7 @@ top:    EOC_TOK {
   YYACCEPT;
 }
 |       cmds END {
+  __propagate_background(&$1);
   push_back_Cmds(&$1, mk_command_holder(NULL, NULL, 0, mk_eoc()));
 
   *__ret_cmds = as_array_Cmds(&$1, NULL);
@@ -97,26 +111,37 @@ top:    EOC_TOK {
 
 
 
+// Pipelines are left recursive so each stage is appended to the end of the
+// array as it is read
 cmds:   cmd_top {
-  Cmds cs = new_Cmds(1);
+  char* err = __apply_time(&$1);
+
+  if (err != NULL) {
+    __command_error(err);
+    YYERROR;
+  }
 
-  push_front_Cmds(&cs, $1);
+  Cmds cs = new_Cmds(2);
+
+  push_back_Cmds(&cs, $1);
 
   $$ = cs;
 }
-|       cmd_top PIPE cmds {
-  CommandHolder prev = pop_front_Cmds(&$3);
+|       cmds PIPE cmd_top {
+  if (($1.data[0].flags & TIME_PIPELINE) && ($3.flags & BACKGROUND)) {
+    __command_error("time: cannot time a background job");
+    YYERROR;
+  }
 
-  $1.flags = ($1.flags & ~(REDIRECT_APPEND | REDIRECT_OUT)) | PIPE_OUT;
-  prev.flags = (prev.flags & ~REDIRECT_IN) | PIPE_IN;
+  CommandHolder prev = peek_back_Cmds(&$1);
 
-  if (prev.flags & BACKGROUND)
-    $1.flags |= BACKGROUND;
+  prev.flags = (prev.flags & ~(REDIRECT_APPEND | REDIRECT_OUT)) | PIPE_OUT;
+  $3.flags = ($3.flags & ~REDIRECT_IN) | PIPE_IN;
 
-  push_front_Cmds(&$3, prev);
-  push_front_Cmds(&$3, $1);
+  update_back_Cmds(&$1, prev);
+  push_back_Cmds(&$1, $3);
 
-  $$ = $3;
+  $$ = $1;
 }
 
 
@@ -133,7 +158,33 @@ cmd_top: cmd_content redir cmd_bg {
 
 
 cmd_content: cmd {
-  $$ = mk_generic_command(as_array_CmdStrs(&$1, NULL));
+  push_back_CmdStrs(&$1, NULL);
+
+  $$ = mk_word_command(as_array_CmdStrs(&$1, NULL));
+}
+|       cmd EQUALS string {
+  // Only `time export NAME=value` gets here, as words the time prefix
+  // turns back into an export
+  size_t skip = (length_CmdStrs(&$1) > 1 && strcmp($1.data[1], "-v") == 0) ? 1 : 0;
+
+  if (length_CmdStrs(&$1) != 3 + skip || strcmp($1.data[0], "time") != 0 ||
+      strcmp($1.data[1 + skip], "export") != 0) {
+    __command_error("syntax error");
+    YYERROR;
+  }
+
+  char* name = $1.data[2 + skip];
+  size_t len = strlen(name);
+  char* assignment = memory_pool_alloc(len + strlen($3) + 2);
+
+  memcpy(assignment, name, len);
+  assignment[len] = '=';
+  strcpy(assignment + len + 1, $3);
+
+  update_back_CmdStrs(&$1, assignment);
+  push_back_CmdStrs(&$1, NULL);
+
+  $$ = mk_word_command(as_array_CmdStrs(&$1, NULL));
 }
 |       ECHO_TOK {
   char** cmd = memory_pool_alloc(sizeof(char*));
@@ -141,30 +192,32 @@ cmd_content: cmd {
   $$ = mk_echo_command(cmd);
 }
 |       ECHO_TOK cmd_arguments {
+  push_back_CmdStrs(&$2, NULL);
+
   $$ = mk_echo_command(as_array_CmdStrs(&$2, NULL));
 }
 |       EXPORT_TOK ID EQUALS string {
   $$ = mk_export_command($2, $4);
 }
 |       CD_TOK {
-  $$ = mk_cd_command(memory_pool_strdup(lookup_env("HOME")));
+  $$ = __mk_cd_command(NULL);
 }
 |       CD_TOK string {
-  char* resolved_path;
-  char* ret = NULL;
-
-  if ((resolved_path = realpath($2, NULL)) != NULL) {
-    ret = memory_pool_strdup(resolved_path);
-    free(resolved_path);
-  }
-
-  $$ = mk_cd_command(ret);
+  $$ = __mk_cd_command($2);
 }
 |       PWD_TOK {
   $$ = mk_pwd_command();
 }
 |       JOBS_TOK {
-  $$ = mk_jobs_command();
+  $$ = mk_jobs_command(false);
+}
+|       JOBS_TOK string {
+  if (strcmp($2, "-l") != 0) {
+    yyerror(__ret_cmds, "jobs: only -l is supported");
+    YYERROR;
+  }
+
+  $$ = mk_jobs_command(true);
 }
 |       EXIT_TOK {
   $$ = mk_exit_command();
@@ -235,34 +288,34 @@ cmd_bg: {
 
 
 
-cmd:    first_string cmd_arguments {
-  push_front_CmdStrs(&$2, $1);
-
-  $$ = $2;
-}
-|       first_string {
-  CmdStrs args = new_CmdStrs(1);
+// Argument lists are left recursive so each word is appended to the end of
+// the array as it is read
+cmd:    first_string {
+  CmdStrs args = new_CmdStrs(4);
 
-  push_front_CmdStrs(&args, $1);
-  push_back_CmdStrs(&args, NULL);
+  push_back_CmdStrs(&args, $1);
 
   $$ = args;
 }
+|       cmd string {
+  push_back_CmdStrs(&$1, $2);
+
+  $$ = $1;
+}
 
 
 
 cmd_arguments: string {
-  CmdStrs args = new_CmdStrs(1);
+  CmdStrs args = new_CmdStrs(4);
 
-  push_front_CmdStrs(&args, $1);
-  push_back_CmdStrs(&args, NULL);
+  push_back_CmdStrs(&args, $1);
 
   $$ = args;
 }
-|       string cmd_arguments {
-  push_front_CmdStrs(&$2, $1);
+|       cmd_arguments string {
+  push_back_CmdStrs(&$1, $2);
 
-  $$ = $2;
+  $$ = $1;
 }
 
 
@@ -297,7 +350,7 @@ special_string: ECHO_TOK {
 }
 
 first_string: STR {
-  $$ = interpret_complex_string_token($1);
+  $$ = $1;
 }
 |       SIM_STR {
   $$ = $1;
@@ -311,6 +364,131 @@ first_string: STR {
 
 %%
 
+// A background marker applies to every earlier stage of the pipeline
+static void __propagate_background(Cmds* cmds) {
+  bool background = false;
+
+  for (size_t i = length_Cmds(cmds); i-- > 0;) {
+    background |= cmds->data[i].flags & BACKGROUND;
+
+    if (background)
+      cmds->data[i].flags |= BACKGROUND;
+  }
+}
+
+// Check if a word is made of digits only, like the NUM token
+static bool __is_number(const char* str) {
+  return *str != '\0' && str[strspn(str, "0123456789")] == '\0';
+}
+
+// Check if a word is one of the builtins the lexer gives a token of its own
+static bool __is_token_builtin(const char* word) {
+  static const char* builtins[] = {
+    "echo", "export", "cd", "pwd", "jobs", "kill", "exit", "quit", NULL
+  };
+
+  for (size_t i = 0; builtins[i] != NULL; ++i)
+    if (strcmp(word, builtins[i]) == 0)
+      return true;
+
+  return false;
+}
+
+// Build the command following the time prefix. The builtins with tokens of
+// their own came through as plain words, so they are matched here the way
+// the cmd_content rules match their tokens. Returns an error message if the
+// words do not fit the builtin.
+static char* __mk_timed_command(char** args, Command* cmd) {
+  size_t num_args = 0;
+
+  while (args[num_args] != NULL)
+    ++num_args;
+
+  char* eq = (num_args == 2) ? strchr(args[1], '=') : NULL;
+
+  if (strcmp(args[0], "echo") == 0)
+    *cmd = mk_echo_command(args + 1);
+  else if (strcmp(args[0], "pwd") == 0 && num_args == 1)
+    *cmd = mk_pwd_command();
+  else if (strcmp(args[0], "jobs") == 0 && num_args == 1)
+    *cmd = mk_jobs_command(false);
+  else if (strcmp(args[0], "jobs") == 0 && num_args == 2) {
+    if (strcmp(args[1], "-l") != 0)
+      return "jobs: only -l is supported";
+
+    *cmd = mk_jobs_command(true);
+  }
+  else if (strcmp(args[0], "cd") == 0 && num_args <= 2)
+    *cmd = __mk_cd_command(args[1]);
+  else if (strcmp(args[0], "kill") == 0 && num_args == 3 &&
+           __is_number(args[1]) && __is_number(args[2]))
+    *cmd = mk_kill_command(args[1], args[2]);
+  else if ((strcmp(args[0], "exit") == 0 || strcmp(args[0], "quit") == 0) &&
+           num_args == 1)
+    *cmd = mk_exit_command();
+  else if (strcmp(args[0], "export") == 0 && eq != NULL && eq != args[1])
+    *cmd = mk_export_command(memory_pool_strndup(args[1], eq - args[1]), eq + 1);
+  else if (__is_token_builtin(args[0]))
+    return "syntax error";
+  else
+    *cmd = mk_word_command(args);
+
+  return NULL;
+}
+
+// The lexer has no keyword for `time`, so a first stage starting with the
+// word is turned into a timed stage of whatever follows it. Returns an error
+// message if the prefix is used wrong.
+static char* __apply_time(CommandHolder* holder) {
+  if (get_command_holder_type(*holder) != GENERIC ||
+      strcmp(holder->cmd.generic.args[0], "time") != 0)
+    return NULL;
+
+  char** args = holder->cmd.generic.args + 1;
+  char flags = TIME_PIPELINE;
+
+  if (args[0] != NULL && strcmp(args[0], "-v") == 0) {
+    flags |= TIME_STAGES;
+    ++args;
+  }
+
+  if (args[0] == NULL)
+    return "time: missing command";
+
+  if (holder->flags & BACKGROUND)
+    return "time: cannot time a background job";
+
+  char* err = __mk_timed_command(args, &holder->cmd);
+
+  if (err == NULL)
+    holder->flags |= flags;
+
+  return err;
+}
+
+// Change to a directory, or to $HOME if it is NULL
+static Command __mk_cd_command(char* dir) {
+  if (dir == NULL)
+    return mk_cd_command(memory_pool_strdup(lookup_env("HOME")));
+
+  char* resolved_path;
+  char* ret = NULL;
+
+  if ((resolved_path = realpath(dir, NULL)) != NULL) {
+    ret = memory_pool_strdup(resolved_path);
+    free(resolved_path);
+  }
+
+  return mk_cd_command(ret);
+}
+
+// Report an error found while reducing a command. The newline ending the
+// command may already have been read, which counts towards the next line.
+static void __command_error(char* str) {
+  fprintf(stderr, "%s: Line %d\n", str, yylineno - (yychar == EOC_TOK));
+}
+
 void yyerror(CommandHolder** cmds, char *str) {
+  (void) cmds; // Silence unused variable warning
   fprintf(stderr, "%s: Line %d\n", str, yylineno);
 }
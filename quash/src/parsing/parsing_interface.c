@@ -1,24 +1,86 @@
 #include "parsing_interface.h"
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "env_cache.h"
+#include "fast_parse.h"
+#include "input_source.h"
 #include "memory_pool.h"
 #include "parse.tab.h"
 
-IMPLEMENT_DEQUE_STRUCT(SizeStack, size_t);
-IMPLEMENT_DEQUE_STRUCT(StrBuilder, char);
-IMPLEMENT_DEQUE_STRUCT(MPStrBuilder, char);
+// Strings are built contiguously so whole runs of characters are appended
+// with one memcpy
+IMPLEMENT_VECTOR_STRUCT(MPStrBuilder, char);
 
-IMPLEMENT_DEQUE(SizeStack, size_t);
-IMPLEMENT_DEQUE(StrBuilder, char);
-IMPLEMENT_DEQUE_MEMORY_POOL(MPStrBuilder, char);
-IMPLEMENT_DEQUE_MEMORY_POOL(CmdStrs, char*);
-IMPLEMENT_DEQUE_MEMORY_POOL(Cmds, CommandHolder);
+IMPLEMENT_VECTOR_MEMORY_POOL(MPStrBuilder, char);
+IMPLEMENT_VECTOR_MEMORY_POOL(CmdStrs, char*);
+IMPLEMENT_VECTOR_MEMORY_POOL(Cmds, CommandHolder);
+
+extern int yylineno;
 
 extern void destroy_lex();
 
+// Script read in place instead of reading stdin
+static char* script_buf = NULL;
+static size_t script_size = 0;
+static bool script_mapped = false;
+
+// Lines are tried on the fast path before the grammar unless QUASH_FAST_PARSE
+// is set to 0
+static int fast_parse_enabled = -1;
+
+// Use the script buffer as the input
+static void __scan_script(char* buf, size_t len, bool mapped) {
+  script_buf = buf;
+  script_size = len;
+  script_mapped = mapped;
+
+  set_input_buffer(script_buf, script_size);
+}
+
+// Read all of fd into a malloc'd buffer
+static char* __read_all(int fd, size_t hint, size_t* len) {
+  // One spare byte so a file of exactly the hinted size reaches end of file
+  // without growing
+  size_t cap = hint + 1;
+  size_t n = 0;
+  char* buf = malloc(cap);
+
+  while (buf != NULL) {
+    if (n == cap) {
+      char* grown = realloc(buf, 2 * cap);
+
+      if (grown == NULL)
+        break;
+
+      buf = grown;
+      cap *= 2;
+    }
+
+    ssize_t got = read(fd, buf + n, cap - n);
+
+    if (got == 0) {
+      *len = n;
+      return buf;
+    }
+
+    if (got > 0)
+      n += got;
+    else if (errno != EINTR)
+      break;
+  }
+
+  free(buf);
+  return NULL;
+}
+
 // Generate a string based off of a pipable generic command
 static inline void __stringify_generic_cmd(GenericCommand cmd, CmdStrs* strs) {
   // Extract argument strings
@@ -54,6 +116,23 @@ static void __stringify_kill_cmd(KillCommand cmd, CmdStrs* strs) {
   push_back_CmdStrs(strs, cmd.job_str);
 }
 
+// Generate a string based off of the hash command
+static void __stringify_hash_cmd(HashCommand cmd, CmdStrs* strs) {
+  push_back_CmdStrs(strs, memory_pool_strdup("hash"));
+
+  // Extract argument strings
+  for (size_t i = 0; cmd.args[i] != NULL; ++i)
+    push_back_CmdStrs(strs, cmd.args[i]);
+}
+
+// Generate a string based off of a builtin that takes a list of words
+static void __stringify_word_cmd(const char* name, char** args, CmdStrs* strs) {
+  push_back_CmdStrs(strs, memory_pool_strdup(name));
+
+  for (size_t i = 0; args[i] != NULL; ++i)
+    push_back_CmdStrs(strs, args[i]);
+}
+
 // Generate a string based off the a variant of a simple command
 static void __stringify_simple_cmd(const char* str, CmdStrs* strs) {
   push_back_CmdStrs(strs, memory_pool_strdup(str));
@@ -88,6 +167,33 @@ static void __stringify_command(Command cmd, CmdStrs* strs) {
 
   case JOBS:
     __stringify_simple_cmd("JOBS", strs);
+
+    if (cmd.jobs.long_format)
+      __stringify_simple_cmd("-l", strs);
+    break;
+
+  case HASH:
+    __stringify_hash_cmd(cmd.hash, strs);
+    break;
+
+  case CAT:
+    __stringify_word_cmd("cat", cmd.cat.args, strs);
+    break;
+
+  case TEE:
+    __stringify_word_cmd("tee", cmd.tee.args, strs);
+    break;
+
+  case FG:
+    __stringify_word_cmd("fg", cmd.fg.args, strs);
+    break;
+
+  case BG:
+    __stringify_word_cmd("bg", cmd.bg.args, strs);
+    break;
+
+  case PARALLEL:
+    __stringify_word_cmd("parallel", cmd.parallel.args, strs);
     break;
 
   case EXIT:
@@ -127,6 +233,12 @@ static void __stringify_script(const CommandHolder* holders, CmdStrs* strs) {
   assert(strs != NULL);
 
   if (holders != NULL) {
+    if (holders[0].flags & TIME_PIPELINE)
+      push_back_CmdStrs(strs, memory_pool_strdup("time"));
+
+    if (holders[0].flags & TIME_STAGES)
+      push_back_CmdStrs(strs, memory_pool_strdup("-v"));
+
     for (size_t i = 0; get_command_holder_type(holders[i]) != EOC; ++i)
       __stringify_holder(holders[i], strs);
 
@@ -137,34 +249,46 @@ static void __stringify_script(const CommandHolder* holders, CmdStrs* strs) {
   push_back_CmdStrs(strs, NULL);
 }
 
-// Concatenates arrays of strings together to form a single string with each
-// string separated by a space.
+// Concatenates arrays of strings together to form a single malloc'd string
+// with each string separated by a space.
 static char* __condense_string_array(char** str_arr) {
-  SizeStack ss = new_SizeStack(10);
   size_t len = 0;
 
-  for (size_t i = 0; str_arr[i] != NULL; ++i) {
-    size_t size = strlen(str_arr[i]) + 1;
-
-    push_back_SizeStack(&ss, size);
-    len += size;
-  }
+  for (size_t i = 0; str_arr[i] != NULL; ++i)
+    len += strlen(str_arr[i]) + 1;
 
-  char* ret = (char*) memory_pool_alloc(len + 1);
+  char* ret = (char*) malloc(len + 1);
   size_t pos = 0;
 
   for (size_t i = 0; str_arr[i] != NULL; ++i) {
-    strcpy(ret + pos, str_arr[i]);
-    pos += pop_front_SizeStack(&ss);
-    ret[pos - 1] = ' ';
+    size_t size = strlen(str_arr[i]);
+
+    memcpy(ret + pos, str_arr[i], size);
+    pos += size;
+    ret[pos++] = ' ';
   }
 
   ret[pos] = '\0';
-  destroy_SizeStack(&ss);
 
   return ret;
 }
 
+// Find the first character of str that is in set, or str + n if there is none.
+// Each search only covers what is left before the previous hit.
+static inline const char* __find_first_of(const char* str, size_t n,
+                                          const char* set) {
+  const char* hit = str + n;
+
+  for (; *set != '\0'; ++set) {
+    const char* p = memchr(str, *set, hit - str);
+
+    if (p != NULL)
+      hit = p;
+  }
+
+  return hit;
+}
+
 // Helper for __interpret_deref: Checks if the character is a valid first
 // character for an identifier
 static inline bool __is_first_identifier_char(char c) {
@@ -177,60 +301,59 @@ static inline bool __is_identifier_char(char c) {
   return isalnum(c) || c == '_';
 }
 
-// Expand an environment variable onto a string
-static void __interpret_deref(MPStrBuilder* bld, const char* str, int* idx) {
+// Expand the environment variable named at the start of str onto a string.
+// Returns a pointer past the name.
+static const char* __interpret_deref(MPStrBuilder* bld, const char* str,
+                                     const char* end) {
   assert(str != NULL);
-  assert(str[*idx] == '$');
-  assert(peek_back_MPStrBuilder(bld) == '$');
-
-  // Remove the dereference symbol at the back of the bld deque
-  pop_back_MPStrBuilder(bld);
 
-  StrBuilder tmp = new_StrBuilder(16);
-  char c;
+  // Since this is intended only as a helper function we assume that
+  // interpret_complex_string token has already noticed a valid first
+  // identifier character after the dereference symbol
+  const char* name_end = str + 1;
 
-  // Extract the identifier characters. Since this is intended only as a helper
-  // function we assume that interpret_complex_string token has already noticed
-  // a valid first identifier character after the dereference symbol.
-  while (__is_identifier_char((c = str[++(*idx)])))
-    push_back_StrBuilder(&tmp, c);
+  while (name_end < end && __is_identifier_char(*name_end))
+    ++name_end;
 
-  // idx increments one too far in the while loop so bring it back down
-  --(*idx);
+  // Looked up by length so the name is never copied
+  size_t val_len;
+  const char* env_var = env_cache_lookup(str, name_end - str, &val_len);
 
-  // Add the null terminator to the string
-  push_back_StrBuilder(&tmp, '\0');
+  if (env_var != NULL)
+    append_MPStrBuilder(bld, env_var, val_len);
 
-  // Extract the id string and lookup the environment variable
-  char* id = as_array_StrBuilder(&tmp, NULL);
-  const char* env_var = lookup_env(id);
-
-  free(id);
-
-  // Append env_var to the string builder
-  if (env_var != NULL) {
-    for (int i = 0; env_var[i] != '\0'; ++i)
-      push_back_MPStrBuilder(bld, env_var[i]);
-  }
+  return name_end;
 }
 
 // Cleans up escapes and unescaped single quotes and expands environment
-// variables found in a string
-char* interpret_complex_string_token(const char* str) {
+// variables. Runs of ordinary characters between the special ones are copied
+// in bulk.
+char* interpret_complex_string_token(const char* str, size_t len) {
   assert(str != NULL);
 
-  MPStrBuilder bld = new_MPStrBuilder(64);
-  int i;
-  int len = strlen(str);
+  MPStrBuilder bld = new_MPStrBuilder(len + 1);
+  const char* p = str;
+  const char* end = str + len;
   bool in_quotes = false;
 
-  for (i = 0; i <= len; ++i) {
-    push_back_MPStrBuilder(&bld, str[i]);
+  while (p < end) {
+    // Variables are not expanded between quotes
+    const char* special = __find_first_of(p, end - p,
+                                          in_quotes ? "\\'" : "\\'$");
 
-    switch (str[i]) {
+    append_MPStrBuilder(&bld, p, special - p);
+
+    if (special == end)
+      break;
+
+    // The token is not terminated so never look past its end
+    p = special + 1;
+    char next = (p < end) ? *p : '\0';
+
+    switch (*special) {
     case '\\':                // Remove valid escape characters
       if (!in_quotes) {
-        switch (str[i+1]) {
+        switch (next) {
         case '\\':
         case '\'':
         case '#':
@@ -241,32 +364,35 @@ char* interpret_complex_string_token(const char* str) {
         case ';':
         case ' ':
         case '\t':
-          update_back_MPStrBuilder(&bld, str[++i]);
+          push_back_MPStrBuilder(&bld, *p++);
           break;
 
         case '\n':
-          pop_back_MPStrBuilder(&bld);
-          ++i;
+          ++p;
           break;
 
         default:
+          push_back_MPStrBuilder(&bld, *special);
           break;
         }
       }
-      else if (str[i+1] == '\'') {
-        update_back_MPStrBuilder(&bld, '\'');
-        ++i;
+      else if (next == '\'') {
+        push_back_MPStrBuilder(&bld, *p++);
+      }
+      else {
+        push_back_MPStrBuilder(&bld, *special);
       }
       break;
 
     case '\'':                // Remove single quotes and toggle quote state
       in_quotes = !in_quotes;
-      pop_back_MPStrBuilder(&bld);
       break;
 
     case '$':                 // Try to dereference environment variables
-      if (!in_quotes && __is_first_identifier_char(str[i + 1]))
-        __interpret_deref(&bld, str, &i);
+      if (__is_first_identifier_char(next))
+        p = __interpret_deref(&bld, p, end);
+      else
+        push_back_MPStrBuilder(&bld, *special);
       break;
 
     default:
@@ -275,13 +401,52 @@ char* interpret_complex_string_token(const char* str) {
   }
 
   // Add a null terminator
-  update_back_MPStrBuilder(&bld, '\0');
+  push_back_MPStrBuilder(&bld, '\0');
 
   assert(!in_quotes);
 
   return as_array_MPStrBuilder(&bld, NULL);
 }
 
+// Check if any argument looks like an option. A lone "-" is a file name.
+static bool __has_options(char** args) {
+  for (size_t i = 0; args[i] != NULL; ++i) {
+    if (args[i][0] == '-' && args[i][1] != '\0')
+      return true;
+  }
+
+  return false;
+}
+
+// Recognize builtins that are spelled as plain words
+Command mk_word_command(char** args) {
+  assert(args != NULL && args[0] != NULL);
+
+  if (strcmp(args[0], "hash") == 0)
+    return mk_hash_command(args + 1);
+
+  if (strcmp(args[0], "fg") == 0)
+    return mk_fg_command(args + 1);
+
+  if (strcmp(args[0], "bg") == 0)
+    return mk_bg_command(args + 1);
+
+  if (strcmp(args[0], "parallel") == 0)
+    return mk_parallel_command(args + 1);
+
+  // Only plain copies are done in quash. Anything with options is left to
+  // the real programs.
+  if (!__has_options(args + 1)) {
+    if (strcmp(args[0], "cat") == 0)
+      return mk_cat_command(args + 1);
+
+    if (strcmp(args[0], "tee") == 0)
+      return mk_tee_command(args + 1);
+  }
+
+  return mk_generic_command(args);
+}
+
 // Build a Redirect structure
 Redirect mk_redirect(char* in, char* out, bool append) {
   return (Redirect) {
@@ -296,19 +461,118 @@ CommandHolder* parse(QuashState* state) {
   assert(state != NULL);
 
   CommandHolder* holders;
+  size_t len;
+  char* line = next_input_line(&len);
 
-  yyparse(&holders);
+  if (fast_parse_enabled < 0) {
+    const char* env = getenv("QUASH_FAST_PARSE");
 
-  if (holders != NULL) {
-    CmdStrs strs = new_CmdStrs(10);
-    __stringify_script(holders, &strs);
-    state->parsed_str = __condense_string_array(as_array_CmdStrs(&strs, NULL));
+    fast_parse_enabled = env == NULL || strcmp(env, "0") != 0;
+  }
+
+  if (line == NULL) {
+    holders = NULL;
+    end_main_loop(EXIT_SUCCESS);
+  }
+  else if (fast_parse_enabled && fast_parse(line, len, &holders)) {
+    // Keep line numbers in the grammar's error messages right
+    ++yylineno;
   }
+  else {
+    unread_input_line();
+    yyparse(&holders);
+  }
+
+  // The string form is only generated if someone asks for it
+  state->parsed_cmds = holders;
 
   return holders;
 }
 
+// Stringify a parsed command line on demand
+char* stringify_script(const CommandHolder* holders) {
+  CmdStrs strs = new_CmdStrs(10);
+
+  __stringify_script(holders, &strs);
+
+  return __condense_string_array(as_array_CmdStrs(&strs, NULL));
+}
+
+// Scan a copy of a string
+void parse_script_string(const char* str) {
+  assert(str != NULL);
+  assert(script_buf == NULL);
+
+  size_t len = strlen(str);
+  char* buf = malloc(len + 1);
+
+  if (buf == NULL) {
+    fprintf(stderr, "ERROR: Failed to allocate the script buffer\n");
+    exit(EXIT_FAILURE);
+  }
+
+  memcpy(buf, str, len);
+  __scan_script(buf, len, false);
+}
+
+// Scan a file, mapping it when it is a regular file
+bool parse_script_file(const char* path) {
+  assert(path != NULL);
+  assert(script_buf == NULL);
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+
+  if (fd < 0)
+    return false;
+
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+
+    close(fd);
+    errno = err;
+    return false;
+  }
+
+  size_t len = st.st_size;
+  char* buf = NULL;
+
+  if (S_ISREG(st.st_mode) && len > 0) {
+    // Private writable mapping since lines may be modified while parsing
+    buf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    if (buf != MAP_FAILED) {
+      close(fd);
+      __scan_script(buf, len, true);
+      return true;
+    }
+  }
+
+  // Pipes and other files without a known size are read until the end
+  buf = __read_all(fd, S_ISREG(st.st_mode) ? len : 65536, &len);
+
+  int err = errno;
+
+  close(fd);
+
+  if (buf == NULL) {
+    errno = err;
+    return false;
+  }
+
+  __scan_script(buf, len, false);
+  return true;
+}
+
 // Clean up dynamically allocated memory in the parser
 void destroy_parser() {
   destroy_lex();
+  destroy_input_source();
+
+  if (script_mapped)
+    munmap(script_buf, script_size);
+  else
+    free(script_buf);
+
+  script_buf = NULL;
 }
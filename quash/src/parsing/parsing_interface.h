@@ -11,7 +11,7 @@
 #include <stdbool.h>
 
 #include "command.h"
-#include "deque.h"
+#include "vector.h"
 #include "quash.h"
 
 /**
@@ -29,23 +29,23 @@ typedef struct Redirect {
 /**
  * @struct CmdStrs
  *
- * @brief Stores strings in a deque
+ * @brief Stores strings in a vector
  *
- * @sa Example
+ * @sa ExampleVector
  */
-IMPLEMENT_DEQUE_STRUCT(CmdStrs, char*);
+IMPLEMENT_VECTOR_STRUCT(CmdStrs, char*);
 
 /**
  * @struct Command
  *
- * @brief Stores @a Command union'd structures in a deque
+ * @brief Stores @a Command union'd structures in a vector
  *
- * @sa Example
+ * @sa ExampleVector
  */
-IMPLEMENT_DEQUE_STRUCT(Cmds, CommandHolder);
+IMPLEMENT_VECTOR_STRUCT(Cmds, CommandHolder);
 
-PROTOTYPE_DEQUE(CmdStrs, char*);
-PROTOTYPE_DEQUE(Cmds, CommandHolder);
+PROTOTYPE_VECTOR(CmdStrs, char*);
+PROTOTYPE_VECTOR(Cmds, CommandHolder);
 /** @endcond Doxygen_Suppress */
 
 
@@ -70,28 +70,47 @@ PROTOTYPE_DEQUE(Cmds, CommandHolder);
  */
 Redirect mk_redirect(char* in, char* out, bool append);
 
+/**
+ * @brief Creates the @a Command for a command made only of plain words
+ *
+ * Builtins without a keyword of their own in the lexer (such as hash) are
+ * recognized here by their first word. cat and tee are only treated as
+ * builtins when none of their arguments is an option. Everything else becomes
+ * a @a GenericCommand.
+ *
+ * @param args A NULL terminated array of strings. The first string is the name
+ * of the command.
+ *
+ * @return A copy of the constructed Command
+ *
+ * @sa GenericCommand, HashCommand, CatCommand, TeeCommand
+ */
+Command mk_word_command(char** args);
+
 /**
  * @brief Clean up a string by removing escape symbols and unescaped single
  * quotes. Also expands any environment variables.
  *
- * @param str The string to clean up
+ * @param str The string to clean up. It does not need to be NUL terminated.
+ *
+ * @param len Length of @a str
  *
  * @return The cleaned up and expanded string allocated on the @a MemoryPool
  *
  * @sa MemoryPool
  */
-char* interpret_complex_string_token(const char* str);
+char* interpret_complex_string_token(const char* str, size_t len);
 
 
 /*************************************************************
  * Functions used by the parser
  *************************************************************/
 /**
- * @brief Handles the call to the parser and provides a string equivalent of the
- * @a Command structure to @a QuashState
+ * @brief Handles the call to the parser and records the parsed @a Command
+ * structure in @a QuashState
  *
- * @param[out] state The state of the quash shell. The parsed_str member of
- * QuashState is set to the stringified command structure.
+ * @param[out] state The state of the quash shell. The parsed_cmds member of
+ * QuashState is set to the parsed command structure.
  *
  * @return A pointer to the parsed command structure
  *
@@ -99,6 +118,43 @@ char* interpret_complex_string_token(const char* str);
  */
 CommandHolder* parse(QuashState* state);
 
+/**
+ * @brief Generate a string equivalent of a parsed command line
+ *
+ * Must be called before the @a MemoryPool holding @a holders is reset.
+ *
+ * @param holders The array returned by parse()
+ *
+ * @return A malloc'd string with each word of the command line separated by a
+ * space. The caller must free it.
+ *
+ * @sa CommandHolder
+ */
+char* stringify_script(const CommandHolder* holders);
+
+/**
+ * @brief Make the parser read a script given as a string instead of stdin
+ *
+ * Must be called before the first call to parse().
+ *
+ * @param str The script text. A copy is made.
+ */
+void parse_script_string(const char* str);
+
+/**
+ * @brief Make the parser read a script file instead of stdin
+ *
+ * The whole file is mapped into memory, or read in one go when it cannot be
+ * mapped, and scanned in place. Must be called before the first call to
+ * parse().
+ *
+ * @param path Path of the script file
+ *
+ * @return True on success and false if the file could not be read, in which
+ * case errno describes the failure
+ */
+bool parse_script_file(const char* path);
+
 /**
  * @brief Cleanup memory dynamically allocated by the parser
  */
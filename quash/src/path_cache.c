@@ -0,0 +1,286 @@
+/**
+ * @file path_cache.c
+ *
+ * @brief Implements the resolved program path table used by run_generic()
+ * and the hash builtin
+ */
+
+#include "path_cache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+/*
+ * @brief A single program name and the location it resolved to
+ */
+typedef struct PathEntry {
+	char* name;	/* Program name as typed, NULL if the slot is free */
+	char* path;	/* Full path to the program */
+	size_t hits;	/* Number of lookups answered by this entry */
+} PathEntry;
+
+// Open addressing table, the capacity is always a power of two
+static PathEntry* table = NULL;
+static size_t table_cap = 0;
+static size_t table_len = 0;
+
+// Lookup totals for the whole session
+static size_t total_hits = 0;
+static size_t total_misses = 0;
+
+// Search path used by execvp() when $PATH is not set
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+// Initial number of slots in the table
+#define INITIAL_CAP 64
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// FNV-1a hash of a program name
+static size_t hash_name(const char* name) {
+
+	uint64_t h = 14695981039346656037ULL;
+
+	for(; *name != '\0'; ++name){
+		h ^= (unsigned char) *name;
+		h *= 1099511628211ULL;
+	}
+
+	return (size_t) h;
+}
+
+
+// Find the slot holding name, or the free slot it belongs in
+static PathEntry* find_slot(const char* name) {
+
+	size_t mask = table_cap - 1;
+	size_t i = hash_name(name) & mask;
+
+	while(NULL != table[i].name && 0 != strcmp(table[i].name, name)){
+		i = (i + 1) & mask;
+	}
+
+	return &table[i];
+}
+
+
+// Free an entry and close the gap it leaves with backward shift deletion,
+// the same way the job table removes a pid, so no tombstones are needed
+static void remove_slot(PathEntry* entry) {
+
+	size_t mask = table_cap - 1;
+	size_t i = entry - table;
+	size_t j = i;
+
+	free(table[i].name);
+	free(table[i].path);
+
+	while(true){
+		j = (j + 1) & mask;
+
+		if(NULL == table[j].name){
+			break;
+		}
+
+		// Entries whose home slot lies cyclically in (i, j] stay put
+		size_t home = hash_name(table[j].name) & mask;
+		if((i <= j) ? (i < home && home <= j) : (i < home || home <= j)){
+			continue;
+		}
+
+		table[i] = table[j];
+		i = j;
+	}
+
+	table[i].name = table[i].path = NULL;
+	--table_len;
+}
+
+
+// Double the table once it is three quarters full
+static void grow_table() {
+
+	PathEntry* old = table;
+	size_t old_cap = table_cap;
+
+	table_cap = (0 == old_cap) ? INITIAL_CAP : 2 * old_cap;
+	table = calloc(table_cap, sizeof(PathEntry));
+
+	if(NULL == table){
+		fprintf(stderr, "ERROR: Failed to allocate the path cache\n");
+		exit(-1);
+	}
+
+	for(size_t i = 0; i < old_cap; ++i){
+		if(NULL != old[i].name){
+			*find_slot(old[i].name) = old[i];
+		}
+	}
+
+	free(old);
+}
+
+
+// Walk $PATH the way execvp() does and return a malloc'd path to the first
+// executable regular file called name
+static char* search_path(const char* name) {
+
+	const char* dirs = getenv("PATH");
+	size_t name_len = strlen(name);
+
+	if(NULL == dirs){
+		dirs = DEFAULT_PATH;
+	}
+
+	while(true){
+		const char* end = strchr(dirs, ':');
+		if(NULL == end){
+			end = dirs + strlen(dirs);
+		}
+		size_t dir_len = end - dirs;
+
+		// An empty entry means the current directory
+		char* candidate = malloc(dir_len + name_len + 3);
+		if(0 == dir_len){
+			candidate[0] = '.';
+			dir_len = 1;
+		}
+		else{
+			memcpy(candidate, dirs, dir_len);
+		}
+		candidate[dir_len] = '/';
+		memcpy(candidate + dir_len + 1, name, name_len + 1);
+
+		struct stat st;
+		if(0 == stat(candidate, &st) && S_ISREG(st.st_mode) &&
+		   0 == access(candidate, X_OK)){
+			return candidate;
+		}
+
+		free(candidate);
+
+		if('\0' == *end){
+			return NULL;
+		}
+		dirs = end + 1;
+	}
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Return the cached path for name, resolving it on a miss
+const char* path_cache_lookup(const char* name) {
+
+	// Paths are executed as given, just like execvp()
+	if(NULL != strchr(name, '/')){
+		return name;
+	}
+
+	if(0 == table_cap){
+		grow_table();
+	}
+
+	PathEntry* entry = find_slot(name);
+
+	if(NULL != entry->name){
+		++entry->hits;
+		++total_hits;
+		return entry->path;
+	}
+
+	++total_misses;
+	return path_cache_refresh(name);
+}
+
+
+// Search for name again and overwrite its entry, or drop it if the name no
+// longer resolves
+const char* path_cache_refresh(const char* name) {
+
+	if(4 * (table_len + 1) > 3 * table_cap){
+		grow_table();
+	}
+
+	char* path = search_path(name);
+	PathEntry* entry = find_slot(name);
+
+	// Names that could not be found are not remembered
+	if(NULL == path){
+		if(NULL != entry->name){
+			remove_slot(entry);
+		}
+		return NULL;
+	}
+
+	if(NULL == entry->name){
+		entry->name = strdup(name);
+		entry->hits = 0;
+		++table_len;
+	}
+
+	free(entry->path);
+	entry->path = path;
+
+	return path;
+}
+
+
+// Empty the table
+void path_cache_reset() {
+
+	for(size_t i = 0; i < table_cap; ++i){
+		free(table[i].name);
+		free(table[i].path);
+		table[i].name = table[i].path = NULL;
+	}
+
+	table_len = 0;
+}
+
+
+// Print the table in the same layout as the bash hash builtin
+void print_path_cache() {
+
+	if(0 == table_len){
+		printf("hash: hash table empty\n");
+	}
+	else{
+		printf("hits\tcommand\n");
+
+		for(size_t i = 0; i < table_cap; ++i){
+			if(NULL != table[i].name){
+				printf("%4zu\t%s\n", table[i].hits, table[i].path);
+			}
+		}
+	}
+
+	printf("lookups: %zu hits, %zu misses\n", total_hits, total_misses);
+
+	fflush(stdout);
+}
+
+
+// Release the table itself
+void destroy_path_cache() {
+
+	path_cache_reset();
+	free(table);
+
+	table = NULL;
+	table_cap = 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file path_cache.h
+ *
+ * @brief A table of program names already resolved against $PATH
+ *
+ * Resolving a program name the way execvp() does means walking every
+ * directory in $PATH. The path cache remembers where each name was found so
+ * later commands can exec the program directly, in the spirit of the bash
+ * hash builtin.
+ */
+
+#ifndef SRC_PATH_CACHE_H
+#define SRC_PATH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Resolve a program name to the path it should be executed from
+ *
+ * Names containing a '/' are returned unchanged and never cached. Other names
+ * are looked up in the table first and only searched for in $PATH on a miss.
+ *
+ * @param name Name of the program (the first argument of a command)
+ *
+ * @return The path to execute, or NULL if no executable named @a name could be
+ * found in $PATH. The string is owned by the cache and stays valid until the
+ * next call to path_cache_reset() or path_cache_refresh().
+ */
+const char* path_cache_lookup(const char* name);
+
+/**
+ * @brief Search $PATH for a program again, replacing any cached location
+ *
+ * Useful when a cached path no longer points at an executable.
+ *
+ * @param name Name of the program
+ *
+ * @return The new path to execute, or NULL if it could not be found
+ */
+const char* path_cache_refresh(const char* name);
+
+/**
+ * @brief Forget every resolved path
+ *
+ * Called when $PATH changes and by `hash -r`. The hit and miss totals are
+ * kept.
+ */
+void path_cache_reset();
+
+/**
+ * @brief Print the cached paths along with their hit counts and the hit and
+ * miss totals to standard out
+ */
+void print_path_cache();
+
+/**
+ * @brief Free all memory held by the path cache
+ */
+void destroy_path_cache();
+
+#endif
@@ -0,0 +1,324 @@
+/**
+ * @file prompt.c
+ *
+ * @brief Implements the cached prompt renderer
+ */
+
+#include "prompt.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pwd.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+/*
+ * @brief Kinds of pieces a compiled prompt is made of
+ */
+typedef enum PromptField {
+	FIELD_TEXT,		/* Literal text */
+	FIELD_USER,		/* \u */
+	FIELD_HOST,		/* \h */
+	FIELD_FULL_HOST,	/* \H */
+	FIELD_CWD,		/* \w */
+	FIELD_CWD_BASE,		/* \W */
+	FIELD_PRIV,		/* \$ */
+} PromptField;
+
+/*
+ * @brief One piece of the compiled prompt
+ */
+typedef struct PromptPart {
+	PromptField field;	/* What to print */
+	size_t start;		/* Offset of literal text in prompt_text */
+	size_t len;		/* Length of literal text */
+} PromptPart;
+
+// Compiled template. Literal text of every part lives in one buffer.
+static PromptPart* parts = NULL;
+static size_t num_parts = 0;
+static char* prompt_text = NULL;
+
+// Values fixed for the whole session
+static char* user = NULL;
+static char host[HOST_NAME_MAX + 1];
+static size_t short_host_len = 0;
+static char priv = '$';
+
+// Working directory, looked up again after invalidate_prompt()
+static char* cwd = NULL;
+
+// Last rendered prompt, reused until something it depends on changes
+static char* rendered = NULL;
+static size_t rendered_len = 0;
+static size_t rendered_cap = 0;
+static bool rendered_valid = false;
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// Append bytes to the rendered prompt
+static void append(const char* str, size_t len) {
+
+	if(rendered_len + len > rendered_cap){
+		while(rendered_len + len > rendered_cap){
+			rendered_cap = (0 == rendered_cap) ? 64 : 2 * rendered_cap;
+		}
+
+		rendered = realloc(rendered, rendered_cap);
+
+		if(NULL == rendered){
+			fprintf(stderr, "ERROR: Failed to allocate the prompt\n");
+			exit(-1);
+		}
+	}
+
+	memcpy(rendered + rendered_len, str, len);
+	rendered_len += len;
+}
+
+
+// Look up the user name, preferring the login name like the original prompt
+static char* find_user() {
+
+	const char* name = getlogin();
+
+	if(NULL == name){
+		name = getenv("USER");
+	}
+
+	if(NULL == name){
+		struct passwd* pw = getpwuid(geteuid());
+		name = (NULL == pw) ? "" : pw->pw_name;
+	}
+
+	return strdup(name);
+}
+
+
+// Print the working directory with $HOME abbreviated to ~
+static void append_cwd() {
+
+	const char* home = getenv("HOME");
+	size_t home_len = (NULL == home) ? 0 : strlen(home);
+
+	if(home_len > 0 && 0 == strncmp(cwd, home, home_len) &&
+	   ('\0' == cwd[home_len] || '/' == cwd[home_len])){
+		append("~", 1);
+		append(cwd + home_len, strlen(cwd + home_len));
+	}
+	else{
+		append(cwd, strlen(cwd));
+	}
+}
+
+
+// Print only the last directory of the working directory
+static void append_cwd_base() {
+
+	const char* last_dir = cwd;
+
+	for(int i = 0; cwd[i] != '\0'; ++i){
+		if(cwd[i] == '/' && cwd[i + 1] != '\0'){
+			last_dir = cwd + i + 1;
+		}
+	}
+
+	append(last_dir, strlen(last_dir));
+}
+
+
+// Fill in the template
+static void render() {
+
+	if(NULL == cwd){
+		cwd = getcwd(NULL, 0);
+
+		if(NULL == cwd){
+			cwd = strdup("");
+		}
+	}
+
+	rendered_len = 0;
+
+	for(size_t i = 0; i < num_parts; ++i){
+		switch(parts[i].field){
+		case FIELD_TEXT:
+			append(prompt_text + parts[i].start, parts[i].len);
+			break;
+
+		case FIELD_USER:
+			append(user, strlen(user));
+			break;
+
+		case FIELD_HOST:
+			append(host, short_host_len);
+			break;
+
+		case FIELD_FULL_HOST:
+			append(host, strlen(host));
+			break;
+
+		case FIELD_CWD:
+			append_cwd();
+			break;
+
+		case FIELD_CWD_BASE:
+			append_cwd_base();
+			break;
+
+		case FIELD_PRIV:
+			append(&priv, 1);
+			break;
+		}
+	}
+
+	rendered_valid = true;
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Cache the session constants and compile the prompt
+void initialize_prompt() {
+
+	user = find_user();
+
+	gethostname(host, HOST_NAME_MAX);
+	host[HOST_NAME_MAX] = '\0';
+	short_host_len = strcspn(host, ".");
+
+	priv = (0 == geteuid()) ? '#' : '$';
+
+	set_prompt_format(getenv("PS1"));
+}
+
+
+// Compile a format into a list of parts
+void set_prompt_format(const char* format) {
+
+	if(NULL == format){
+		format = DEFAULT_PROMPT_FORMAT;
+	}
+
+	size_t len = strlen(format);
+
+	// A format never compiles to more parts or text than it has characters
+	free(parts);
+	free(prompt_text);
+	parts = malloc((len + 1) * sizeof(PromptPart));
+	prompt_text = malloc(len + 1);
+	num_parts = 0;
+
+	if(NULL == parts || NULL == prompt_text){
+		fprintf(stderr, "ERROR: Failed to compile the prompt\n");
+		exit(-1);
+	}
+
+	size_t text_len = 0;
+
+	for(size_t i = 0; i < len; ++i){
+		PromptField field = FIELD_TEXT;
+		char c = format[i];
+
+		if('\\' == c && i + 1 < len){
+			switch(format[++i]){
+			case 'u': field = FIELD_USER; break;
+			case 'h': field = FIELD_HOST; break;
+			case 'H': field = FIELD_FULL_HOST; break;
+			case 'w': field = FIELD_CWD; break;
+			case 'W': field = FIELD_CWD_BASE; break;
+			case '$': field = FIELD_PRIV; break;
+			case 'n': c = '\n'; break;
+			case '\\': c = '\\'; break;
+
+			// Bash brackets terminal control sequences with \[ and \]
+			case '[':
+			case ']': continue;
+
+			// Unknown escapes are printed as they are
+			default: --i; break;
+			}
+		}
+
+		if(FIELD_TEXT != field){
+			parts[num_parts++] = (PromptPart) { field, 0, 0 };
+			continue;
+		}
+
+		// Merge runs of literal text into one part
+		if(0 == num_parts || FIELD_TEXT != parts[num_parts - 1].field){
+			parts[num_parts++] = (PromptPart) { FIELD_TEXT, text_len, 0 };
+		}
+
+		prompt_text[text_len++] = c;
+		++parts[num_parts - 1].len;
+	}
+
+	rendered_valid = false;
+}
+
+
+// Forget the working directory
+void invalidate_prompt() {
+
+	free(cwd);
+	cwd = NULL;
+	rendered_valid = false;
+}
+
+
+// Print the cached prompt, rendering it first if needed
+void print_prompt() {
+
+	if(!rendered_valid){
+		render();
+	}
+
+	// Anything printed through stdio must come out before the prompt
+	fflush(stdout);
+
+	size_t done = 0;
+
+	while(done < rendered_len){
+		ssize_t n = write(STDOUT_FILENO, rendered + done, rendered_len - done);
+
+		if(n < 0 && EINTR != errno){
+			break;
+		}
+		else if(n > 0){
+			done += n;
+		}
+	}
+}
+
+
+// Release everything
+void destroy_prompt() {
+
+	free(parts);
+	free(prompt_text);
+	free(user);
+	free(cwd);
+	free(rendered);
+
+	parts = NULL;
+	prompt_text = NULL;
+	user = NULL;
+	cwd = NULL;
+	rendered = NULL;
+	num_parts = rendered_len = rendered_cap = 0;
+	rendered_valid = false;
+}
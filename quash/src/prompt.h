@@ -0,0 +1,61 @@
+/**
+ * @file prompt.h
+ *
+ * @brief Renders the interactive prompt from cached values
+ *
+ * The prompt format is compiled once into a template of literal text and
+ * fields. The user name and host name never change during a session and are
+ * looked up once, while the working directory is only looked up again after
+ * it was invalidated by a cd. The rendered prompt is kept until one of its
+ * inputs changes and is printed with a single write().
+ *
+ * The format uses the same escapes as the bash PS1 variable:
+ *
+ * - \\u  user name
+ * - \\h  host name up to the first '.'
+ * - \\H  full host name
+ * - \\w  working directory with $HOME abbreviated to ~
+ * - \\W  last component of the working directory
+ * - \\$  '#' for root and '$' for everyone else
+ * - \\n  newline
+ * - \\\\  backslash
+ */
+
+#ifndef SRC_PROMPT_H
+#define SRC_PROMPT_H
+
+/**
+ * @brief Prompt used when $PS1 is not set
+ */
+#define DEFAULT_PROMPT_FORMAT "[QUASH - \\u@\\h \\W]$ "
+
+/**
+ * @brief Look up the session constants and compile the format in $PS1, or
+ * DEFAULT_PROMPT_FORMAT if it is not set
+ */
+void initialize_prompt();
+
+/**
+ * @brief Replace the prompt format
+ *
+ * @param format The new format. NULL selects DEFAULT_PROMPT_FORMAT.
+ */
+void set_prompt_format(const char* format);
+
+/**
+ * @brief Mark the working directory and $HOME as changed so they are looked
+ * up again before the next prompt
+ */
+void invalidate_prompt();
+
+/**
+ * @brief Write the prompt to stdout
+ */
+void print_prompt();
+
+/**
+ * @brief Free the compiled template and cached values
+ */
+void destroy_prompt();
+
+#endif
@@ -9,16 +9,23 @@
  **************************************************************************/
 #include "quash.h"
 
-#include <limits.h>
+#include <errno.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 
 #include "command.h"
+#include "debug.h"
 #include "execute.h"
 #include "parsing_interface.h"
 #include "memory_pool.h"
+#include "env_cache.h"
+#include "path_cache.h"
+#include "prompt.h"
+#include "reaper.h"
+#include "trace.h"
 
 /**************************************************************************
  * Private Variables
@@ -36,45 +43,6 @@ static QuashState initial_state() {
 	};
 }
 
-// Print a prompt for a command
-static void print_prompt() {
-	bool should_free = true;
-	char* cwd = get_current_directory(&should_free);
-
-	assert(cwd != NULL);
-
-	char hostname[HOST_NAME_MAX];
-
-	// Get the hostname
-	gethostname(hostname, HOST_NAME_MAX);
-
-	// Remove first period and everything afterwards
-	for (int i = 0; hostname[i] != '\0'; ++i) {
-		if (hostname[i] == '.') {
-			hostname[i] = '\0';
-			break;
-		}
-	}
-
-	char* last_dir = cwd;
-	// Show only last directory
-	for (int i = 0; cwd[i] != '\0'; ++i) {
-		if (cwd[i] == '/' && cwd[i + 1] != '\0') {
-			last_dir = cwd + i + 1;
-		}
-	}
-
-	char* username = getlogin();
-
-	// print the prompt
-	printf("[QUASH - %s@%s %s]$ ", username, hostname, last_dir);
-
-	fflush(stdout);
-
-	if (should_free)
-		free(cwd);
-}
-
 /**************************************************************************
  * Public Functions
  **************************************************************************/
@@ -83,9 +51,9 @@ bool is_running() {
 	return state.running;
 }
 
-// Get a copy of the string
+// Generate the string for the current command line
 char* get_command_string() {
-	return strdup(state.parsed_str);
+	return stringify_script(state.parsed_cmds);
 }
 
 // Check if Quash is receiving input from the command line or not
@@ -110,7 +78,33 @@ void end_main_loop() {
 int main(int argc, char** argv) {
 	state = initial_state();
 
+	initialize_trace();
+	atexit(destroy_trace);
+
+	// Batch mode: quash -c 'command line' or quash script.qsh
+	if (argc > 1) {
+		if (0 == strcmp(argv[1], "-c")) {
+			if (argc < 3) {
+				fprintf(stderr, "Usage: %s [-c command | script]\n", argv[0]);
+				return EXIT_FAILURE;
+			}
+
+			parse_script_string(argv[2]);
+		}
+		else if (!parse_script_file(argv[1])) {
+			fprintf(stderr, "ERROR: Failed to read script %s: %s\n",
+				argv[1], strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		// Scripts never show the banner or prompts
+		state.is_a_tty = false;
+	}
+
 	if (is_tty()) {
+		initialize_prompt();
+		atexit(destroy_prompt);
+
 		puts("Welcome to Quash!");
 		puts("Type \"exit\" or \"quit\" to quit");
 		puts("---------------------------------");
@@ -119,21 +113,50 @@ int main(int argc, char** argv) {
 
 	atexit(destroy_parser);
 	atexit(destroy_memory_pool);
+	atexit(destroy_path_cache);
+	atexit(destroy_env_cache);
+
+	initialize_reaper();
+	atexit(destroy_reaper);
+
+	// Jobs get the terminal while they run in the foreground
+	if (is_tty())
+		initialize_job_control();
+
+	// Builtin pipeline stages write to pipes from inside quash, so a reader
+	// that exits early must show up as EPIPE instead of killing the shell
+	signal(SIGPIPE, SIG_IGN);
+
+	// The pool is rewound after each line rather than rebuilt, so the
+	// memory grown for one line is reused by the next
+	initialize_memory_pool(1024);
 
 	// Main execution loop
 	while (is_running()) {
 		if (is_tty())
 			print_prompt();
 
-		initialize_memory_pool(1024);
+		// Parsing includes waiting for the line to be read
+		double start = trace_begin();
 		CommandHolder* script = parse(&state);
+		trace_end("parse", start, 0, -1);
 
-		if (script != NULL)
+		if (script != NULL) {
+			start = trace_begin();
 			run_script(script);
+			trace_end("line", start, 0, -1);
+		}
 
-		destroy_memory_pool();
+		reset_memory_pool();
 	}
 
+	IFDEBUG(MemoryPoolStats stats = get_memory_pool_stats());
+	PRINT_DEBUG("memory pool: %zu bytes reused, %zu bytes fresh, "
+		    "%zu bytes recycled, %zu extended in place, "
+		    "%zu blocks allocated, %zu blocks freed\n",
+		    stats.bytes_reused, stats.bytes_fresh, stats.bytes_recycled,
+		    stats.extensions, stats.pools_allocated, stats.pools_freed);
+
 	// There is no way to know downstream that we are done, so we must use a
 	// function to signal the cleanup
 	free_background_queue();
@@ -15,7 +15,6 @@
 #include <sys/wait.h>
 #include "execute.h"
 #include "pid_queue.h"
-#include "job_queue.h"
 #include "job_struct.h"
 
 /**
@@ -25,8 +24,10 @@ typedef struct QuashState {
   bool running;     /**< Indicates if Quash should keep accept more input */
   bool is_a_tty;    /**< Indicates if the shell is receiving input from a file
                      * or the command line */
-  char* parsed_str; /**< Holds a string representing the parsed structure of the
-                     * command input from the command line */
+  const CommandHolder* parsed_cmds; /**< The structure parsed from the most
+                                    * recent command line. It is only turned
+                                    * back into a string when one is asked
+                                    * for. */
 } QuashState;
 
 /**
@@ -37,7 +38,11 @@ typedef struct QuashState {
 bool is_tty();
 
 /**
- * @brief Get a deep copy of the current command string
+ * @brief Get a string representing the current command line
+ *
+ * The string is generated from the parsed structure on each call, so it should
+ * only be requested when it is needed, such as when a job is moved to the
+ * background.
  *
  * @note The free function must be called on the result eventually
  *
@@ -0,0 +1,177 @@
+/**
+ * @file reaper.c
+ *
+ * @brief Implements the SIGCHLD driven child reaper
+ */
+
+#define _GNU_SOURCE
+
+#include "reaper.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+// Self-pipe carrying ExitRecords from the signal handler to quash
+static int reap_pipe[2] = { -1, -1 };
+
+// Room for this many bytes of unread records before the handler has to
+// fall back on the overflow buffer. Pipes refuse sizes above
+// /proc/sys/fs/pipe-max-size, in which case the default capacity is kept.
+#define REAP_PIPE_SIZE (1 << 20)
+
+// Records that did not fit in the pipe, oldest first. Once one is here every
+// later record goes here too until quash has read them all, which keeps the
+// records of each child in order. While it is full the handler stops
+// reaping, so children are left as zombies instead of losing their status.
+#define OVERFLOW_SIZE 64
+static ExitRecord overflow[OVERFLOW_SIZE];
+static volatile sig_atomic_t num_overflow = 0;
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+/*
+ * @brief Collects every child that has exited, stopped or continued and
+ * queues a record for each
+ *
+ * Only async-signal-safe calls are made here. Records are smaller than
+ * PIPE_BUF so each write() is atomic.
+ */
+static void on_sigchld(int sig) {
+
+	(void) sig; // Silence unused variable warning
+
+	int saved_errno = errno;
+	ExitRecord rec;
+
+	// A child is only reaped when there is somewhere to keep its record
+	while(num_overflow < OVERFLOW_SIZE &&
+	      (rec.pid = wait4(-1, &rec.status, WNOHANG | WUNTRACED | WCONTINUED,
+			       &rec.usage)) > 0){
+		if(0 < num_overflow ||
+		   write(reap_pipe[1], &rec, sizeof(rec)) != sizeof(rec)){
+			overflow[num_overflow++] = rec;
+		}
+	}
+
+	errno = saved_errno;
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Set up the self-pipe and SIGCHLD handler
+void initialize_reaper() {
+
+	if(0 != pipe2(reap_pipe, O_CLOEXEC | O_NONBLOCK)){
+		perror("ERROR: Failed to create the reaper pipe");
+		exit(-1);
+	}
+
+	fcntl(reap_pipe[1], F_SETPIPE_SZ, REAP_PIPE_SIZE);
+
+	struct sigaction sa;
+	sa.sa_handler = on_sigchld;
+	// Stopped children are reported too so job control can see them
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if(0 != sigaction(SIGCHLD, &sa, NULL)){
+		perror("ERROR: Failed to install the SIGCHLD handler");
+		exit(-1);
+	}
+}
+
+
+// Take the oldest record that did not fit in the pipe
+static bool poll_overflow(ExitRecord* rec) {
+
+	if(0 == num_overflow){
+		return false;
+	}
+
+	// The handler runs on this thread, so blocking it here is enough
+	sigset_t sigchld, old;
+	sigemptyset(&sigchld);
+	sigaddset(&sigchld, SIGCHLD);
+	pthread_sigmask(SIG_BLOCK, &sigchld, &old);
+
+	bool was_full = OVERFLOW_SIZE == num_overflow;
+
+	*rec = overflow[0];
+	memmove(overflow, overflow + 1, --num_overflow * sizeof(ExitRecord));
+
+	// Children left unreaped while the buffer was full are collected now
+	if(was_full){
+		on_sigchld(SIGCHLD);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	return true;
+}
+
+
+// Read one record if there is one. Callers report their own errors after
+// checking for exited jobs, so errno is left alone.
+bool reaper_poll(ExitRecord* rec) {
+
+	int saved_errno = errno;
+	ssize_t n;
+
+	do{
+		n = read(reap_pipe[0], rec, sizeof(*rec));
+	} while(n < 0 && EINTR == errno);
+
+	// Records in the pipe are older than any in the overflow buffer
+	bool found = n == sizeof(*rec) || poll_overflow(rec);
+
+	errno = saved_errno;
+
+	return found;
+}
+
+
+// Wait for the next record
+void reaper_wait(ExitRecord* rec) {
+
+	struct pollfd pfd = { reap_pipe[0], POLLIN, 0 };
+
+	while(!reaper_poll(rec)){
+		if(poll(&pfd, 1, -1) < 0 && EINTR != errno){
+			perror("ERROR: Failed to wait for child processes");
+			exit(-1);
+		}
+	}
+}
+
+
+// Stop reaping and release the pipe
+void destroy_reaper() {
+
+	signal(SIGCHLD, SIG_DFL);
+
+	if(reap_pipe[0] >= 0){
+		close(reap_pipe[0]);
+		close(reap_pipe[1]);
+	}
+
+	reap_pipe[0] = reap_pipe[1] = -1;
+}
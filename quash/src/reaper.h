@@ -0,0 +1,62 @@
+/**
+ * @file reaper.h
+ *
+ * @brief Reaps child processes as soon as they exit
+ *
+ * A SIGCHLD handler collects every exited child with wait4() and writes a
+ * record of it, including the resources it used, into a self-pipe. Children
+ * that are stopped or continued by a signal are reported the same way, with a
+ * status for WIFSTOPPED() or WIFCONTINUED(). Zombies are therefore cleaned up
+ * even while quash is blocked waiting for input, and the rest of quash learns
+ * about each exited child by reading one record instead of polling every pid
+ * it knows about.
+ */
+
+#ifndef SRC_REAPER_H
+#define SRC_REAPER_H
+
+#include <stdbool.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+/**
+ * @brief Everything the reaper learned about one exited, stopped or continued
+ * child
+ */
+typedef struct ExitRecord {
+	pid_t pid;	/**< Process id of the child */
+	int status;	/**< Status as reported by waitpid() */
+	struct rusage usage;	/**< Resources used by the child, only filled in
+				 * once it has exited */
+} ExitRecord;
+
+/**
+ * @brief Create the self-pipe and install the SIGCHLD handler
+ *
+ * Must be called before any child process is created.
+ */
+void initialize_reaper();
+
+/**
+ * @brief Fetch the next exit record without blocking
+ *
+ * @param[out] rec Filled in with the record if one was available
+ *
+ * @return True if a record was read and false if no child has exited since the
+ * last record was read
+ */
+bool reaper_poll(ExitRecord* rec);
+
+/**
+ * @brief Block until a child exits and fetch its record
+ *
+ * @param[out] rec Filled in with the record of the exited child
+ */
+void reaper_wait(ExitRecord* rec);
+
+/**
+ * @brief Restore the default SIGCHLD disposition and close the self-pipe
+ */
+void destroy_reaper();
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file trace.c
+ *
+ * @brief Implements the QUASH_TRACE execution trace
+ */
+
+#define _GNU_SOURCE
+
+#include "trace.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/****************************************************************************
+ * Globals
+ ***************************************************************************/
+
+// File the events go to, -1 while tracing is off. Each event is one write()
+// to a file opened with O_APPEND, so threads and forked children never
+// interleave their events.
+static int trace_fd = -1;
+
+// The process that opened the trace and finishes it at exit
+static pid_t trace_owner = 0;
+
+// Longest event written. Names are short literals, so this is never hit.
+#define EVENT_SIZE 512
+
+
+/****************************************************************************
+ * Private Functions
+ ***************************************************************************/
+
+// Microseconds of CLOCK_MONOTONIC, the clock trace viewers line spans up on
+static double now_us() {
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+// Write one event of the given phase. The opening '[' and the metadata
+// event are written first, so every later event follows a comma.
+static void write_event(const char* name, char phase, double ts, double dur,
+			pid_t pid, int job_id) {
+
+	char buf[EVENT_SIZE];
+	int len = snprintf(buf, sizeof(buf), ",\n{\"name\":\"%s\",\"cat\":\"quash\","
+			   "\"ph\":\"%c\",\"ts\":%.3f,", name, phase, ts);
+
+	if('X' == phase){
+		len += snprintf(buf + len, sizeof(buf) - len, "\"dur\":%.3f,", dur);
+	}
+	else{
+		len += snprintf(buf + len, sizeof(buf) - len, "\"s\":\"t\",");
+	}
+
+	len += snprintf(buf + len, sizeof(buf) - len,
+			"\"pid\":%d,\"tid\":%d,\"args\":{", getpid(), gettid());
+
+	if(pid > 0){
+		len += snprintf(buf + len, sizeof(buf) - len, "\"pid\":%d%s",
+				pid, (job_id >= 0) ? "," : "");
+	}
+	if(job_id >= 0){
+		len += snprintf(buf + len, sizeof(buf) - len, "\"job\":%d",
+				job_id);
+	}
+
+	len += snprintf(buf + len, sizeof(buf) - len, "}}");
+
+	if(len > 0 && len < (int) sizeof(buf) && write(trace_fd, buf, len) < 0){
+		// A trace that cannot be written is not worth stopping for
+	}
+}
+
+
+/****************************************************************************
+ * Interface Functions
+ ***************************************************************************/
+
+// Open the trace file named in the environment
+void initialize_trace() {
+
+	const char* path = getenv("QUASH_TRACE");
+
+	if(NULL == path || '\0' == *path){
+		return;
+	}
+
+	trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+			0644);
+
+	if(trace_fd < 0){
+		perror("ERROR: Failed to open QUASH_TRACE");
+		return;
+	}
+
+	trace_owner = getpid();
+
+	char buf[EVENT_SIZE];
+	int len = snprintf(buf, sizeof(buf), "[\n{\"name\":\"process_name\","
+			   "\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"quash\"}}",
+			   trace_owner);
+
+	if(write(trace_fd, buf, len) < 0){
+		// Reported by the viewer as an empty trace
+	}
+}
+
+
+// Check if spans are being written
+bool trace_enabled() {
+	return trace_fd >= 0;
+}
+
+
+// Take the start time of a span
+double trace_begin() {
+	return (trace_fd < 0) ? 0 : now_us();
+}
+
+
+// Write a span that ends now
+void trace_end(const char* name, double start, pid_t pid, int job_id) {
+
+	if(trace_fd < 0){
+		return;
+	}
+
+	write_event(name, 'X', start, now_us() - start, pid, job_id);
+}
+
+
+// Write an event that has no duration
+void trace_instant(const char* name, pid_t pid, int job_id) {
+
+	if(trace_fd < 0){
+		return;
+	}
+
+	write_event(name, 'i', now_us(), 0, pid, job_id);
+}
+
+
+// Close the array and the file
+void destroy_trace() {
+
+	if(trace_fd < 0){
+		return;
+	}
+
+	if(getpid() == trace_owner && write(trace_fd, "\n]\n", 3) < 0){
+		// Viewers accept a trace without the closing bracket
+	}
+
+	close(trace_fd);
+	trace_fd = -1;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file trace.h
+ *
+ * @brief Runtime trace of what quash does, in the Chrome trace event format
+ *
+ * When QUASH_TRACE names a file as quash starts, every step of running a line
+ * is written to it as a span: parsing, setting up pipes, spawning and forking
+ * children, running builtins and waiting for jobs. Each span carries its
+ * start and duration in microseconds of CLOCK_MONOTONIC, and the pid and job
+ * id it concerns. The file loads in Perfetto or chrome://tracing. Without
+ * QUASH_TRACE every call below returns right away.
+ */
+
+#ifndef SRC_TRACE_H
+#define SRC_TRACE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * @brief Open the file named by QUASH_TRACE, if it is set
+ *
+ * Must be called before any child process is created.
+ */
+void initialize_trace();
+
+/**
+ * @brief Check if spans are being written
+ *
+ * @return True if QUASH_TRACE named a file that could be opened
+ */
+bool trace_enabled();
+
+/**
+ * @brief Take the start time of a span
+ *
+ * @return The current time in microseconds, or 0 if tracing is off
+ */
+double trace_begin();
+
+/**
+ * @brief Write a span that started at @a start and ends now
+ *
+ * Safe to call from any thread and from forked children, which show up as
+ * threads and processes of their own.
+ *
+ * @param name What the span covers
+ *
+ * @param start Start time returned by trace_begin()
+ *
+ * @param pid Process the span concerns, or 0 for none
+ *
+ * @param job_id Job the span concerns, or -1 for none
+ */
+void trace_end(const char* name, double start, pid_t pid, int job_id);
+
+/**
+ * @brief Write an event that has no duration
+ *
+ * @param name What happened
+ *
+ * @param pid Process the event concerns, or 0 for none
+ *
+ * @param job_id Job the event concerns, or -1 for none
+ */
+void trace_instant(const char* name, pid_t pid, int job_id);
+
+/**
+ * @brief Finish the trace and close the file
+ *
+ * Children forked from quash leave the file for quash to finish.
+ */
+void destroy_trace();
+
+#endif
@@ -0,0 +1,495 @@
+/**
+ * @file vector.h
+ *
+ * @brief Growable contiguous array generators specialized to any given type.
+ *
+ * A vector only grows and shrinks at the back. Compared to a deque it needs no
+ * modulo arithmetic to find an element, never wastes a slot, and is already
+ * laid out as a plain array so extracting one with as_array is free. Use a
+ * deque only when elements are removed from the front.
+ */
+
+#ifndef SRC_VECTOR_H
+#define SRC_VECTOR_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @def IMPLEMENT_VECTOR_STRUCT(struct_name, type)
+ *
+ * @brief Generates a structure for use with vectors.
+ *
+ * Follow this call with either @a PROTOTYPE_VECTOR() (if in a header file) or
+ * @a IMPLEMENT_VECTOR() to generate the functions that correspond to this
+ * structure. The elements may be read directly through the `data` and `len`
+ * fields, but the fields should only be changed through the generated
+ * functions.
+ *
+ * @param struct_name The name of the structure
+ *
+ * @param type The name of the type of elements stored in the @a struct_name
+ * structure
+ *
+ * @sa PROTOTYPE_VECTOR, IMPLEMENT_VECTOR
+*/
+#define IMPLEMENT_VECTOR_STRUCT(struct_name, type)                      \
+  typedef struct struct_name {                                          \
+    type* data;                                                         \
+    size_t len;                                                         \
+    size_t cap;                                                         \
+                                                                        \
+    void (*destructor)(type);                                           \
+  } struct_name;
+
+/**
+ * @def PROTOTYPE_VECTOR(struct_name, type)
+ *
+ * @brief Generates prototypes for functions that manipulate vector structures.
+ *
+ * This is intended for use in a header file or anywhere you need a forward
+ * declaration of these functions. This does not actually implement these
+ * functions.
+ *
+ * @param struct_name The name of the structure
+ *
+ * @param type The name of the type of elements stored in the @a struct_name
+ * structure
+ *
+ * @sa IMPLEMENT_VECTOR_STRUCT(), IMPLEMENT_VECTOR()
+ */
+#define PROTOTYPE_VECTOR(struct_name, type)                             \
+  struct_name new_##struct_name(size_t);                                \
+  struct_name new_destructable_##struct_name(size_t, void (*)(type));   \
+  void destroy_##struct_name(struct_name*);                             \
+  void empty_##struct_name(struct_name*);                               \
+  bool is_empty_##struct_name(struct_name*);                            \
+  size_t length_##struct_name(struct_name*);                            \
+  type* as_array_##struct_name(struct_name*, size_t*);                  \
+  void apply_##struct_name(struct_name*, void (*)(type));               \
+  void push_back_##struct_name(struct_name*, type);                     \
+  void append_##struct_name(struct_name*, const type*, size_t);         \
+  type pop_back_##struct_name(struct_name*);                            \
+  type peek_back_##struct_name(struct_name*);                           \
+  type get_##struct_name(struct_name*, size_t);                         \
+  void update_##struct_name(struct_name*, size_t, type);                \
+  void update_back_##struct_name(struct_name*, type);
+
+/**
+ * @def __IMPLEMENT_VECTOR_COMMON(struct_name, type)
+ *
+ * @brief Generates the vector functions that do not allocate. Used by @a
+ * IMPLEMENT_VECTOR() and @a IMPLEMENT_VECTOR_MEMORY_POOL() after they define
+ * `__grow_##struct_name()`.
+ */
+#define __IMPLEMENT_VECTOR_COMMON(struct_name, type)                    \
+                                                                        \
+  struct_name new_destructable_##struct_name(size_t init_cap,           \
+                                             void (*destructor)(type)){ \
+    struct_name ret = new_##struct_name(init_cap);                      \
+    ret.destructor = destructor;                                        \
+    return ret;                                                         \
+  }                                                                     \
+                                                                        \
+  void apply_##struct_name(struct_name* vec, void (*func)(type)) {      \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+                                                                        \
+    for (size_t i = 0; i < vec->len; ++i)                               \
+      func(vec->data[i]);                                               \
+  }                                                                     \
+                                                                        \
+  void empty_##struct_name(struct_name* vec) {                          \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+                                                                        \
+    if (vec->destructor != NULL)                                        \
+      apply_##struct_name(vec, vec->destructor);                        \
+                                                                        \
+    vec->len = 0;                                                       \
+  }                                                                     \
+                                                                        \
+  bool is_empty_##struct_name(struct_name* vec) {                       \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+    return vec->len == 0;                                               \
+  }                                                                     \
+                                                                        \
+  size_t length_##struct_name(struct_name* vec) {                       \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+    return vec->len;                                                    \
+  }                                                                     \
+                                                                        \
+  type* as_array_##struct_name(struct_name* vec, size_t* len) {         \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+                                                                        \
+    type* ret = vec->data;                                              \
+                                                                        \
+    if (len != NULL)                                                    \
+      *len = vec->len;                                                  \
+                                                                        \
+    vec->data = NULL;                                                   \
+    vec->cap = vec->len = 0;                                            \
+                                                                        \
+    return ret;                                                         \
+  }                                                                     \
+                                                                        \
+  void push_back_##struct_name(struct_name* vec, type element) {        \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+                                                                        \
+    if (vec->len == vec->cap)                                           \
+      __grow_##struct_name(vec, vec->len + 1);                          \
+                                                                        \
+    vec->data[vec->len++] = element;                                    \
+  }                                                                     \
+                                                                        \
+  void append_##struct_name(struct_name* vec, const type* elements,     \
+                            size_t n) {                                 \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+                                                                        \
+    if (vec->len + n > vec->cap)                                        \
+      __grow_##struct_name(vec, vec->len + n);                          \
+                                                                        \
+    memcpy(vec->data + vec->len, elements, n * sizeof(type));           \
+    vec->len += n;                                                      \
+  }                                                                     \
+                                                                        \
+  type pop_back_##struct_name(struct_name* vec) {                       \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+                                                                        \
+    if (vec->len == 0) {                                                \
+      fprintf(stderr, "ERROR: Cannot pop from of struct_name while it " \
+              "is empty\n");                                            \
+      abort();                                                          \
+    }                                                                   \
+                                                                        \
+    return vec->data[--vec->len];                                       \
+  }                                                                     \
+                                                                        \
+  type peek_back_##struct_name(struct_name* vec) {                      \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+    assert(vec->len > 0);                                               \
+    return vec->data[vec->len - 1];                                     \
+  }                                                                     \
+                                                                        \
+  type get_##struct_name(struct_name* vec, size_t idx) {                \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+    assert(idx < vec->len);                                             \
+    return vec->data[idx];                                              \
+  }                                                                     \
+                                                                        \
+  void update_##struct_name(struct_name* vec, size_t idx,               \
+                            type element) {                             \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+    assert(idx < vec->len);                                             \
+    vec->data[idx] = element;                                           \
+  }                                                                     \
+                                                                        \
+  void update_back_##struct_name(struct_name* vec, type element) {      \
+    assert(vec != NULL);                                                \
+    assert(vec->data != NULL); /* Make sure the structure is valid */   \
+    assert(vec->len > 0);                                               \
+    vec->data[vec->len - 1] = element;                                  \
+  }
+
+/**
+ * @def IMPLEMENT_VECTOR(struct_name, type)
+ *
+ * @brief Generates a @a malloc based set of functions for use with a structure
+ * generated by @a IMPLEMENT_VECTOR_STRUCT()
+ *
+ * @param struct_name The name of the structure
+ *
+ * @param type The name of the type of elements stored in the @a struct_name
+ * structure
+ *
+ * @sa IMPLEMENT_VECTOR_STRUCT(), PROTOTYPE_VECTOR()
+ */
+#define IMPLEMENT_VECTOR(struct_name, type)                             \
+                                                                        \
+  void apply_##struct_name(struct_name*, void (*)(type));               \
+                                                                        \
+  struct_name new_##struct_name(size_t init_cap) {                      \
+    struct_name ret;                                                    \
+                                                                        \
+    if (init_cap > 0)                                                   \
+      ret.cap = init_cap;                                               \
+    else                                                                \
+      ret.cap = 1;                                                      \
+                                                                        \
+    ret.data = (type*) malloc(ret.cap * sizeof(type));                  \
+                                                                        \
+    if (ret.data == NULL) {                                             \
+      fprintf(stderr, "ERROR: Failed to allocate struct_name"           \
+              " contents");                                             \
+      exit(-1);                                                         \
+    }                                                                   \
+                                                                        \
+    ret.len = 0;                                                        \
+    ret.destructor = NULL;                                              \
+                                                                        \
+    return ret;                                                         \
+  }                                                                     \
+                                                                        \
+  void destroy_##struct_name(struct_name* vec) {                        \
+    assert(vec != NULL);                                                \
+                                                                        \
+    if (vec->data == NULL)                                              \
+      return;                                                           \
+                                                                        \
+    if (vec->destructor != NULL)                                        \
+      apply_##struct_name(vec, vec->destructor);                        \
+                                                                        \
+    free(vec->data);                                                    \
+                                                                        \
+    vec->data = NULL;                                                   \
+    vec->cap = vec->len = 0;                                            \
+  }                                                                     \
+                                                                        \
+  static void __grow_##struct_name(struct_name* vec, size_t min_cap) {  \
+    size_t cap = 2 * vec->cap;                                          \
+                                                                        \
+    if (cap < min_cap)                                                  \
+      cap = min_cap;                                                    \
+                                                                        \
+    type* data = (type*) realloc(vec->data, cap * sizeof(type));        \
+                                                                        \
+    if (data == NULL) {                                                 \
+      fprintf(stderr, "ERROR: Failed to reallocate struct_name"         \
+              " contents\n");                                           \
+      abort();                                                          \
+    }                                                                   \
+                                                                        \
+    vec->data = data;                                                   \
+    vec->cap = cap;                                                     \
+  }                                                                     \
+                                                                        \
+  __IMPLEMENT_VECTOR_COMMON(struct_name, type)
+
+// The following vector is for example and documentation purposes only
+
+/** @brief An example type used for example purposes only */
+typedef char Type;
+
+/**
+ * @struct ExampleVector
+ *
+ * @brief A data structure generated by IMPLEMENT_VECTOR_STRUCT() to store the
+ * state of a vector.
+ *
+ * @note The members of this struct may be read but should only be modified
+ * with the functions generated by the IMPLEMENT_VECTOR() macro.
+ *
+ * @sa IMPLEMENT_VECTOR()
+ */
+// The following is the struct created by the expansion of
+// IMPLEMENT_VECTOR_STRUCT(ExampleVector, Type);
+typedef struct ExampleVector {
+  Type* data;   /**< The array holding the elements */
+  size_t len;   /**< The number of elements in the vector */
+  size_t cap;   /**< The current capacity of the vector */
+
+  void (*destructor)(Type); /**< Optional destructor function pointer for the
+                             *  data type. This is called on every element in
+                             *  the vector when @a destroy_ExampleVector() is
+                             *  called. */
+} ExampleVector;
+
+/**
+ * @fn ExampleVector new_ExampleVector(size_t init_cap)
+ *
+ * @brief Create a new, fully initialized vector structure
+ *
+ * @param init_cap Initial capacity of the vector
+ *
+ * @return A copy of the fully initialized struct
+ *
+ * @sa ExampleVector
+ */
+/**
+ * @fn ExampleVector new_destructable_ExampleVector(size_t init_cap, void
+ * (*destructor)(Type))
+ *
+ * @brief Create a new vector with a destructor that is applied to every
+ * element when @a destroy_ExampleVector() or @a empty_ExampleVector() is
+ * called
+ *
+ * @param init_cap Initial capacity of the vector
+ *
+ * @param destructor A function that is run on each element in the vector
+ *
+ * @return A copy of the fully initialized struct
+ *
+ * @sa ExampleVector
+ */
+/**
+ * @fn void destroy_ExampleVector(ExampleVector* vec)
+ *
+ * @brief Destroy the vector structure freeing memory if necessary
+ *
+ * @param vec A pointer to the vector to destroy
+ *
+ * @sa ExampleVector
+ */
+/**
+ * @fn void empty_ExampleVector(ExampleVector* vec)
+ *
+ * @brief Remove every element, calling the destructor on each one if a
+ * destructor was specified. The capacity is kept.
+ *
+ * @param vec A pointer to the vector to empty
+ *
+ * @sa ExampleVector
+ */
+/**
+ * @fn bool is_empty_ExampleVector(ExampleVector* vec)
+ *
+ * @brief Checks if the vector is empty
+ *
+ * @param vec A pointer to the vector to check
+ *
+ * @return Returns true if empty and false if not empty
+ *
+ * @sa ExampleVector
+ */
+/**
+ * @fn size_t length_ExampleVector(ExampleVector* vec)
+ *
+ * @brief Query the number of elements in the vector
+ *
+ * @param vec A pointer to the vector
+ *
+ * @return The number of elements in the vector
+ *
+ * @sa ExampleVector
+ */
+/**
+ * @fn Type* as_array_ExampleVector(ExampleVector* vec, size_t* len)
+ *
+ * @brief Take the array out of the vector. No elements are moved or copied.
+ *
+ * @note Calling this function on a vector will invalidate the vector. This
+ * means no further vector functions can be called on it until it is
+ * reinitialized with @a new_ExampleVector(). If this function was created with
+ * the @a IMPLEMENT_VECTOR() macro, then the destructor is never called and you
+ * will be responsible for freeing the memory of the array.
+ *
+ * @param vec A pointer to the vector to extract an array from
+ *
+ * @param[out] len Set to the number of elements if it is not NULL
+ *
+ * @return The array of elements
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn void apply_ExampleVector(ExampleVector* vec, void (*func)(Type))
+ *
+ * @brief Calls the function func on every element in order
+ *
+ * @param vec A pointer to the vector
+ *
+ * @param func A pointer to a function that takes an element of type
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn void push_back_ExampleVector(ExampleVector* vec, Type element)
+ *
+ * @brief Add an element to the end of the vector in amortized constant time
+ *
+ * @param vec A pointer to the vector
+ *
+ * @param element The element to copy into the vector
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn void append_ExampleVector(ExampleVector* vec, const Type* elements,
+ * size_t n)
+ *
+ * @brief Copy n elements to the end of the vector with a single memcpy
+ *
+ * @param vec A pointer to the vector
+ *
+ * @param elements The elements to copy. They must not be inside the vector.
+ *
+ * @param n Number of elements to copy
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn Type pop_back_ExampleVector(ExampleVector* vec)
+ *
+ * @brief Remove the last element of the vector
+ *
+ * @param vec A pointer to the vector
+ *
+ * @return A copy of the element removed
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn Type peek_back_ExampleVector(ExampleVector* vec)
+ *
+ * @brief Get a copy of the last element of the vector
+ *
+ * @param vec A pointer to the vector
+ *
+ * @return A copy of the last element
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn Type get_ExampleVector(ExampleVector* vec, size_t idx)
+ *
+ * @brief Get a copy of the element at an index
+ *
+ * @param vec A pointer to the vector
+ *
+ * @param idx Index of the element, which must be less than the length
+ *
+ * @return A copy of the element
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn void update_ExampleVector(ExampleVector* vec, size_t idx, Type element)
+ *
+ * @brief Replace the element at an index. The destructor is not called on the
+ * old element.
+ *
+ * @param vec A pointer to the vector
+ *
+ * @param idx Index of the element, which must be less than the length
+ *
+ * @param element The new element
+ *
+ * @sa ExampleVector, Type
+ */
+/**
+ * @fn void update_back_ExampleVector(ExampleVector* vec, Type element)
+ *
+ * @brief Replace the last element. The destructor is not called on the old
+ * element.
+ *
+ * @param vec A pointer to the vector
+ *
+ * @param element The new element
+ *
+ * @sa ExampleVector, Type
+ */
+PROTOTYPE_VECTOR(ExampleVector, Type);
+
+#endif //SRC_VECTOR_H